@@ -1,5 +1,6 @@
 #include "array.h"
 
+#include "resolver.h"
 #include "value.h"
 #include "vm/instruction.h"
 
@@ -9,13 +10,19 @@ ast::array::array(std::vector<std::unique_ptr<ast::expression>>&& members)
   : m_members {move(members)}
 { }
 
-std::vector<vm::command> ast::array::generate() const
+void ast::array::resolve(resolver& res) const
 {
-  std::vector<vm::command> vec;
+  for (const auto& i : m_members)
+    i->resolve(res);
+}
+
+vm::bytecode ast::array::generate() const
+{
+  vm::bytecode vec;
 
   for (const auto& i : m_members) {
     const auto arg = i->code();
-    copy(begin(arg), end(arg), back_inserter(vec));
+    vec.append(arg);
   }
 
   vec.emplace_back( vm::instruction::parr,
@@ -9,9 +9,18 @@ ast::assignment::assignment(symbol name, std::unique_ptr<expression>&& value)
     m_value {move(value)}
 { }
 
-std::vector<vm::command> ast::assignment::generate() const
+void ast::assignment::resolve(resolver& res) const
+{
+  m_value->resolve(res);
+  m_var = res.lookup(m_name);
+}
+
+vm::bytecode ast::assignment::generate() const
 {
   auto vec = m_value->code();
-  vec.emplace_back(vm::instruction::write, m_name);
+  if (m_var)
+    vec.emplace_back(vm::instruction::lwrite, *m_var);
+  else
+    vec.emplace_back(vm::instruction::write, m_name);
   return vec;
 }
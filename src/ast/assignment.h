@@ -2,6 +2,7 @@
 #define VV_AST_ASSIGNMENT_H
 
 #include "expression.h"
+#include "resolver.h"
 
 namespace vv {
 
@@ -11,11 +12,14 @@ class assignment : public expression {
 public:
   assignment(symbol name, std::unique_ptr<expression>&& value);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   symbol m_name;
   std::unique_ptr<expression> m_value;
+  mutable boost::optional<vm::local_variable> m_var;
+
 };
 
 }
@@ -1,6 +1,5 @@
 #include "block.h"
 
-#include "opt.h"
 #include "vm/instruction.h"
 
 using namespace vv;
@@ -9,7 +8,15 @@ ast::block::block(std::vector<std::unique_ptr<expression>>&& subexpressions)
   : m_subexpressions {move(subexpressions)}
 { }
 
-std::vector<vm::command> ast::block::generate() const
+void ast::block::resolve(resolver& res) const
+{
+  res.enter_block(m_layout);
+  for (const auto& i : m_subexpressions)
+    i->resolve(res);
+  res.leave();
+}
+
+vm::bytecode ast::block::generate() const
 {
   // Conceptually, *every* block statement consists of
   //   eblk
@@ -25,17 +32,22 @@ std::vector<vm::command> ast::block::generate() const
   // But since the only time the pnil is actually used is when there are no
   // expressions, and since in that case the e/lblk don't change any semantics,
   // there's no reason not to special-case it
+  //
+  // If the resolver found the block doesn't declare anything, it doesn't need
+  // an environment at all.
 
-  std::vector<vm::command> vec{ {vm::instruction::eblk} };
+  vm::bytecode vec;
+  if (m_layout.has_env)
+    vec.emplace_back(vm::instruction::eblk, m_layout.slots);
   vec.emplace_back(vm::instruction::pnil);
 
   for (const auto& i : m_subexpressions) {
     const auto subexpr = i->code();
     vec.emplace_back(vm::instruction::pop, 1);
-    copy(begin(subexpr), end(subexpr), back_inserter(vec));
+    vec.append(subexpr);
   }
 
-  vec.push_back(vm::instruction::lblk);
-  optimize_independent_block(vec);
+  if (m_layout.has_env)
+    vec.push_back(vm::instruction::lblk);
   return vec;
 }
@@ -2,6 +2,7 @@
 #define VV_AST_BLOCK_H
 
 #include "expression.h"
+#include "resolver.h"
 
 namespace vv {
 
@@ -11,10 +12,13 @@ class block : public expression {
 public:
   block(std::vector<std::unique_ptr<expression>>&& subexpressions);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   std::vector<std::unique_ptr<expression>> m_subexpressions;
+  mutable scope_layout m_layout;
+
 };
 
 }
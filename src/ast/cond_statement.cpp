@@ -1,5 +1,6 @@
 #include "cond_statement.h"
 
+#include "resolver.h"
 #include "value.h"
 #include "vm/instruction.h"
 
@@ -11,9 +12,17 @@ ast::cond_statement::cond_statement(
   : m_body {move(body)}
 { }
 
-std::vector<vm::command> ast::cond_statement::generate() const
+void ast::cond_statement::resolve(resolver& res) const
 {
-  std::vector<vm::command> vec;
+  for (const auto& i : m_body) {
+    i.first->resolve(res);
+    i.second->resolve(res);
+  }
+}
+
+vm::bytecode ast::cond_statement::generate() const
+{
+  vm::bytecode vec;
   std::vector<size_t> jump_to_end_idxs;
 
   vec.emplace_back(vm::instruction::pnil);
@@ -21,24 +30,24 @@ std::vector<vm::command> ast::cond_statement::generate() const
   for (const auto& i : m_body) {
     vec.emplace_back(vm::instruction::pop, 1); // pop prev failed test result
     const auto test = i.first->code();
-    copy(begin(test), end(test), back_inserter(vec));
+    vec.append(test);
     vec.emplace_back(vm::instruction::jf);
     const auto jump_to_next_test_idx = vec.size() - 1;
 
     vec.emplace_back(vm::instruction::pop, 1); // pop test result
     const auto body = i.second->code();
-    copy(begin(body), end(body), back_inserter(vec));
+    vec.append(body);
     vec.emplace_back(vm::instruction::jmp);
     jump_to_end_idxs.push_back(vec.size() - 1);
 
-    const auto jump_sz = static_cast<value::integer>(vec.size() - jump_to_next_test_idx - 1);
+    const auto jump_sz = static_cast<int32_t>(vec.size() - jump_to_next_test_idx - 1);
     vec[jump_to_next_test_idx].arg = jump_sz;
   }
 
   vec.emplace_back(vm::instruction::pop, 1);
   vec.emplace_back(vm::instruction::pnil);
   for (auto i : jump_to_end_idxs) {
-    const auto jump_sz = static_cast<value::integer>(vec.size() - i - 1);
+    const auto jump_sz = static_cast<int32_t>(vec.size() - i - 1);
     vec[i].arg = jump_sz;
   }
 
@@ -12,7 +12,8 @@ public:
   cond_statement(std::vector<std::pair<std::unique_ptr<expression>,
                                        std::unique_ptr<expression>>>&& body);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   std::vector<std::pair<std::unique_ptr<expression>,
@@ -1,5 +1,6 @@
 #include "dictionary.h"
 
+#include "resolver.h"
 #include "vm/instruction.h"
 
 using namespace vv;
@@ -8,13 +9,19 @@ ast::dictionary::dictionary(std::vector<std::unique_ptr<ast::expression>>&& memb
   : m_members  {move(members)}
 { }
 
-std::vector<vm::command> ast::dictionary::generate() const
+void ast::dictionary::resolve(resolver& res) const
 {
-  std::vector<vm::command> vec;
+  for (const auto& i : m_members)
+    i->resolve(res);
+}
+
+vm::bytecode ast::dictionary::generate() const
+{
+  vm::bytecode vec;
 
   for (const auto& i : m_members) {
     const auto arg = i->code();
-    copy(begin(arg), end(arg), back_inserter(vec));
+    vec.append(arg);
   }
 
   vec.emplace_back(vm::instruction::pdict,
@@ -11,7 +11,8 @@ class dictionary : public expression {
 public:
   dictionary(std::vector<std::unique_ptr<ast::expression>>&& members);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   std::unique_ptr<ast::expression> m_function;
@@ -1,5 +1,6 @@
 #include "except.h"
 
+#include "resolver.h"
 #include "vm/instruction.h"
 
 using namespace vv;
@@ -8,7 +9,12 @@ ast::except::except(std::unique_ptr<expression>&& value)
   : m_value {move(value)}
 { }
 
-std::vector<vm::command> ast::except::generate() const
+void ast::except::resolve(resolver& res) const
+{
+  m_value->resolve(res);
+}
+
+vm::bytecode ast::except::generate() const
 {
   auto vec = m_value->code();
   vec.emplace_back(vm::instruction::exc);
@@ -11,7 +11,8 @@ class except : public expression {
 public:
   except(std::unique_ptr<expression>&& value);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   std::unique_ptr<expression> m_value;
@@ -14,43 +14,48 @@ ast::for_loop::for_loop(symbol iterator,
 { }
 
 // TODO: clean up substantially
-std::vector<vm::command> ast::for_loop::generate() const
+void ast::for_loop::resolve(resolver& res) const
+{
+  m_range->resolve(res);
+  res.enter_block(m_layout);
+  m_var = res.declare(m_iterator);
+  m_body->resolve(res);
+  res.leave();
+}
+
+// The iteration itself is handled by 'itstart' and 'itnext', which step through
+// Arrays and Ranges of Integers directly, and through anything else with the
+// usual start/at_end/get/increment methods.
+vm::bytecode ast::for_loop::generate() const
 {
   auto vec = m_range->code();
-  vec.emplace_back(vm::instruction::method, symbol{"start"});
-  vec.emplace_back(vm::instruction::call, 0);
-
-  const auto test_idx = static_cast<value::integer>(vec.size() - 1);
-  vec.emplace_back(vm::instruction::dup);
-  vec.emplace_back(vm::instruction::opt_at_end);
-  vec.emplace_back(vm::instruction::jt);
-  const auto jmp_to_end_idx = static_cast<value::integer>(vec.size() - 1);
-
-  vec.emplace_back(vm::instruction::eblk); // enter new scope for iterator var
-  vec.emplace_back(vm::instruction::pop, 1); // clear result of at_end test
-  vec.emplace_back(vm::instruction::dup); // duplicate iterator
-  vec.emplace_back(vm::instruction::opt_get);
-  vec.emplace_back(vm::instruction::let, m_iterator);
+  vec.emplace_back(vm::instruction::itstart);
+
+  const auto next_idx = vec.size();
+  vec.emplace_back(vm::instruction::itnext);
+
+  // enter new scope for iterator var
+  vec.emplace_back(vm::instruction::eblk, m_layout.slots);
+  if (m_var)
+    vec.emplace_back(vm::instruction::llet, *m_var);
+  else
+    vec.emplace_back(vm::instruction::let, m_iterator);
   vec.emplace_back(vm::instruction::pop, 1); // clear m_iterator value
   const auto body_code = m_body->code();
-  copy(begin(body_code), end(body_code), back_inserter(vec));
+  vec.append(body_code);
   vec.emplace_back(vm::instruction::lblk);
-
   vec.emplace_back(vm::instruction::pop, 1); // clear result of body code
 
-  vec.emplace_back(vm::instruction::dup); // duplicate iterator
-  vec.emplace_back(vm::instruction::opt_incr);
-  vec.emplace_back(vm::instruction::pop, 1); // clear garbage returned by incr
-
+  const auto jmp_back_idx = vec.size();
   vec.emplace_back(vm::instruction::jmp);
-  const auto jmp_back_idx = static_cast<value::integer>(vec.size() - 1);
 
-  const auto end_idx = static_cast<value::integer>(vec.size() - 1);
-  vec.emplace_back(vm::instruction::pop, 2); // clear iterator and at_end result
+  const auto end_idx = vec.size();
+  vec.emplace_back(vm::instruction::pop, 3); // clear iteration
   vec.emplace_back(vm::instruction::pnil);
 
-  vec[jmp_to_end_idx].arg = end_idx - jmp_to_end_idx;
-  vec[jmp_back_idx].arg = test_idx - jmp_back_idx;
+  vec[next_idx].arg = static_cast<int32_t>(end_idx - next_idx) - 1;
+  vec[jmp_back_idx].arg = static_cast<int32_t>(next_idx)
+                        - static_cast<int32_t>(jmp_back_idx) - 1;
 
   return vec;
 }
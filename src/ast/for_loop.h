@@ -2,6 +2,7 @@
 #define VV_AST_FOR_LOOP_H
 
 #include "expression.h"
+#include "resolver.h"
 
 namespace vv {
 
@@ -13,12 +14,16 @@ public:
            std::unique_ptr<expression>&& range,
            std::unique_ptr<expression>&& body);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   symbol m_iterator;
   std::unique_ptr<expression> m_range;
   std::unique_ptr<expression> m_body;
+  mutable scope_layout m_layout;
+  mutable boost::optional<vm::local_variable> m_var;
+
 };
 
 }
@@ -1,5 +1,6 @@
 #include "function_call.h"
 
+#include "resolver.h"
 #include "vm/instruction.h"
 
 using namespace vv;
@@ -11,19 +12,25 @@ ast::function_call::function_call(
     m_args     {move(args)}
 { }
 
-std::vector<vm::command> ast::function_call::generate() const
+void ast::function_call::resolve(resolver& res) const
 {
-  std::vector<vm::command> vec;
+  for_each(rbegin(m_args), rend(m_args), [&](auto& i) { i->resolve(res); });
+  m_function->resolve(res);
+}
+
+vm::bytecode ast::function_call::generate() const
+{
+  vm::bytecode vec;
 
   //for (const auto& i : m_args) {
   for_each(rbegin(m_args), rend(m_args), [&](auto& i)
   {
     const auto arg = i->code();
-    copy(begin(arg), end(arg), back_inserter(vec));
+    vec.append(arg);
   });
 
   const auto fn = m_function->code();
-  copy(begin(fn), end(fn), back_inserter(vec));
+  vec.append(fn);
 
   vec.emplace_back(vm::instruction::call, static_cast<int>(m_args.size()));
   return vec;
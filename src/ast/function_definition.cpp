@@ -15,35 +15,65 @@ ast::function_definition::function_definition(symbol name,
     m_vararg_name {vararg_name}
 { }
 
-std::vector<vm::command> ast::function_definition::generate() const
+void ast::function_definition::resolve(resolver& res) const
 {
+  res.enter_function(m_layout);
+  m_arg_vars.clear();
+  for (const auto& i : m_args)
+    m_arg_vars.push_back(res.declare(i));
+  if (m_vararg_name)
+    m_vararg_var = res.declare(*m_vararg_name);
+  m_body->resolve(res);
+  res.leave();
+
+  if (m_name != symbol{})
+    m_var = res.declare(m_name);
+}
+
+vm::bytecode ast::function_definition::generate() const
+{
+  // Functions nested in this one are resolved along with it
+  if (!m_layout.resolved)
+    resolver::resolve_function(*this);
+
   const auto argc = static_cast<int>(m_args.size());
-  std::vector<vm::command> definition;
+  vm::bytecode definition;
   for (auto i = argc; i--;) {
     definition.emplace_back(vm::instruction::arg, i);
-    definition.emplace_back(vm::instruction::let, m_args[i]);
+    if (const auto& var = m_arg_vars[static_cast<size_t>(i)])
+      definition.emplace_back(vm::instruction::llet, *var);
+    else
+      definition.emplace_back(vm::instruction::let, m_args[i]);
     definition.emplace_back(vm::instruction::pop, 1);
   }
 
   if (m_vararg_name) {
     definition.emplace_back(vm::instruction::varg, argc);
-    definition.emplace_back(vm::instruction::let, *m_vararg_name);
+    if (m_vararg_var)
+      definition.emplace_back(vm::instruction::llet, *m_vararg_var);
+    else
+      definition.emplace_back(vm::instruction::let, *m_vararg_name);
     definition.emplace_back(vm::instruction::pop, 1);
   }
 
   const auto body = m_body->code();
-  copy(begin(body), end(body), back_inserter(definition));
+  definition.append(body);
   definition.emplace_back(vm::instruction::ret, false);
 
   optimize_independent_block(definition);
 
-  std::vector<vm::command> vec;
+  vm::bytecode vec;
   // ternary == poor man's cast cause I can't be bothered to look at the
   // boost::optional docs atm
   vec.emplace_back( vm::instruction::pfn,
-                    vm::function_t{argc, move(definition), m_vararg_name ? true : false} );
+                    vm::function_t{argc,
+                                   std::move(definition),
+                                   m_vararg_name ? true : false,
+                                   m_layout.slots} );
 
-  if (m_name != symbol{})
+  if (m_var)
+    vec.emplace_back(vm::instruction::llet, *m_var);
+  else if (m_name != symbol{})
     vec.emplace_back(vm::instruction::let, m_name);
 
   return vec;
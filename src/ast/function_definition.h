@@ -2,6 +2,7 @@
 #define VV_AST_FUNCTION_DEFINITION_H
 
 #include "expression.h"
+#include "resolver.h"
 
 #include <boost/optional/optional.hpp>
 
@@ -16,13 +17,19 @@ public:
                       const std::vector<symbol>& args,
                       boost::optional<symbol> vararg_name = {});
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   symbol m_name;
   std::shared_ptr<expression> m_body;
   std::vector<symbol> m_args;
   boost::optional<symbol> m_vararg_name;
+
+  mutable scope_layout m_layout;
+  mutable std::vector<boost::optional<vm::local_variable>> m_arg_vars;
+  mutable boost::optional<vm::local_variable> m_vararg_var;
+  mutable boost::optional<vm::local_variable> m_var;
 };
 
 }
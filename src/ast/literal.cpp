@@ -4,42 +4,50 @@
 
 using namespace vv;
 
-std::vector<vm::command> ast::literal::boolean::generate() const
+vm::bytecode ast::literal::boolean::generate() const
 {
   return { {vm::instruction::pbool, m_val} };
 }
 
-std::vector<vm::command> ast::literal::character::generate() const
+vm::bytecode ast::literal::character::generate() const
 {
   return { {vm::instruction::pchar, m_val} };
 }
 
-std::vector<vm::command> ast::literal::floating_point::generate() const
+vm::bytecode ast::literal::floating_point::generate() const
 {
-  return { {vm::instruction::pflt, m_val} };
+  vm::bytecode vec;
+  vec.emplace_back(vm::instruction::pflt, m_val);
+  return vec;
 }
 
-std::vector<vm::command> ast::literal::integer::generate() const
+vm::bytecode ast::literal::integer::generate() const
 {
-  return { {vm::instruction::pint, m_val} };
+  vm::bytecode vec;
+  vec.emplace_back(vm::instruction::pint, m_val);
+  return vec;
 }
 
-std::vector<vm::command> ast::literal::nil::generate() const
+vm::bytecode ast::literal::nil::generate() const
 {
   return { {vm::instruction::pnil} };
 }
 
-std::vector<vm::command> ast::literal::regex::generate() const
+vm::bytecode ast::literal::regex::generate() const
 {
-  return { {vm::instruction::pre, m_val} };
+  vm::bytecode vec;
+  vec.emplace_back(vm::instruction::pre, m_val);
+  return vec;
 }
 
-std::vector<vm::command> ast::literal::string::generate() const
+vm::bytecode ast::literal::string::generate() const
 {
-  return { {vm::instruction::pstr, m_val} };
+  vm::bytecode vec;
+  vec.emplace_back(vm::instruction::pstr, m_val);
+  return vec;
 }
 
-std::vector<vm::command> ast::literal::symbol::generate() const
+vm::bytecode ast::literal::symbol::generate() const
 {
   return { {vm::instruction::psym, m_val} };
 }
@@ -12,7 +12,7 @@ namespace literal {
 class boolean : public expression {
 public:
   boolean(bool val) : m_val{val} { }
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
 private:
   bool m_val;
 };
@@ -20,7 +20,7 @@ private:
 class character : public expression {
 public:
   character(char val) : m_val{val} { }
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
 private:
   char m_val;
 };
@@ -28,7 +28,7 @@ private:
 class floating_point : public expression {
 public:
   floating_point(double val) : m_val{val} { }
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
 private:
   double m_val;
 };
@@ -36,20 +36,20 @@ private:
 class integer : public expression {
 public:
   integer(int64_t val) : m_val{val} { }
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
 private:
   int64_t m_val;
 };
 
 class nil : public expression {
 public:
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
 };
 
 class regex : public expression {
 public:
   regex(const std::string& val) : m_val{val} { }
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
 private:
   std::string m_val;
 };
@@ -57,7 +57,7 @@ private:
 class string : public expression {
 public:
   string(const std::string& val) : m_val{val} { }
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
 private:
   std::string m_val;
 };
@@ -65,7 +65,7 @@ private:
 class symbol : public expression {
 public:
   symbol(vv::symbol val) : m_val{val} { }
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
 private:
   vv::symbol m_val;
 };
@@ -1,5 +1,6 @@
 #include "logical_and.h"
 
+#include "resolver.h"
 #include "value.h"
 #include "vm/instruction.h"
 
@@ -11,7 +12,13 @@ ast::logical_and::logical_and(std::unique_ptr<expression>&& left,
     m_right {move(right)}
 { }
 
-std::vector<vm::command> ast::logical_and::generate() const
+void ast::logical_and::resolve(resolver& res) const
+{
+  m_left->resolve(res);
+  m_right->resolve(res);
+}
+
+vm::bytecode ast::logical_and::generate() const
 {
   // Given conditions 'a' and 'b', generate the following VM instructions:
   //   a
@@ -27,7 +34,7 @@ std::vector<vm::command> ast::logical_and::generate() const
   vec.emplace_back(vm::instruction::pop, 1);
 
   const auto right = m_right->code();
-  copy(begin(right), end(right), back_inserter(vec));
+  vec.append(right);
   vec.emplace_back(vm::instruction::jf, 3);
   vec.emplace_back(vm::instruction::pop, 1);
   vec.emplace_back(vm::instruction::pbool, true);
@@ -36,6 +43,6 @@ std::vector<vm::command> ast::logical_and::generate() const
   vec.emplace_back(vm::instruction::pbool, false);
 
   const auto false_idx = vec.size() - 1;
-  vec[jmp_to_false_idx].arg = static_cast<value::integer>(false_idx - jmp_to_false_idx);
+  vec[jmp_to_false_idx].arg = static_cast<int32_t>(false_idx - jmp_to_false_idx);
   return vec;
 }
@@ -12,7 +12,8 @@ public:
   logical_or(std::unique_ptr<expression>&& left,
              std::unique_ptr<expression>&& right);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   std::unique_ptr<expression> m_left;
@@ -8,7 +8,9 @@ ast::member::member(vv::symbol name)
   : m_name   {name}
 { }
 
-std::vector<vm::command> ast::member::generate() const
+vm::bytecode ast::member::generate() const
 {
-  return { { vm::instruction::readm, m_name } };
+  vm::bytecode vec;
+  vec.emplace_back(vm::instruction::readm, m_name);
+  return vec;
 }
@@ -11,7 +11,7 @@ class member : public expression {
 public:
   member(vv::symbol name);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
 
 private:
   vv::symbol m_name;
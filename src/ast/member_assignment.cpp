@@ -1,5 +1,6 @@
 #include "member_assignment.h"
 
+#include "resolver.h"
 #include "vm/instruction.h"
 
 using namespace vv;
@@ -10,7 +11,12 @@ ast::member_assignment::member_assignment(vv::symbol name,
     m_value  {move(value)}
 { }
 
-std::vector<vm::command> ast::member_assignment::generate() const
+void ast::member_assignment::resolve(resolver& res) const
+{
+  m_value->resolve(res);
+}
+
+vm::bytecode ast::member_assignment::generate() const
 {
   auto vec = m_value->code();
   vec.emplace_back(vm::instruction::writem, m_name);
@@ -11,7 +11,8 @@ class member_assignment : public expression {
 public:
   member_assignment(vv::symbol name, std::unique_ptr<ast::expression>&& value);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   vv::symbol m_name;
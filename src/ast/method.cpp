@@ -1,5 +1,6 @@
 #include "method.h"
 
+#include "resolver.h"
 #include "vm/instruction.h"
 
 using namespace vv;
@@ -9,7 +10,12 @@ ast::method::method(std::unique_ptr<ast::expression>&& object, vv::symbol name)
     m_name   {name}
 { }
 
-std::vector<vm::command> ast::method::generate() const
+void ast::method::resolve(resolver& res) const
+{
+  m_object->resolve(res);
+}
+
+vm::bytecode ast::method::generate() const
 {
   auto vec = m_object->code();
   vec.emplace_back(vm::instruction::method, m_name);
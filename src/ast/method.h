@@ -11,7 +11,8 @@ class method : public expression {
 public:
   method(std::unique_ptr<ast::expression>&& object, vv::symbol name);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   std::unique_ptr<ast::expression> m_object;
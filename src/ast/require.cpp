@@ -1,5 +1,6 @@
 #include "require.h"
 
+#include "resolver.h"
 #include "vm/instruction.h"
 
 using namespace vv;
@@ -8,7 +9,14 @@ ast::require::require(const std::string& filename)
   : m_filename {filename}
 { }
 
-std::vector<vm::command> ast::require::generate() const
+void ast::require::resolve(resolver& res) const
 {
-  return std::vector<vm::command>{ {vm::instruction::req, m_filename} };
+  res.modifies_env();
+}
+
+vm::bytecode ast::require::generate() const
+{
+  vm::bytecode vec;
+  vec.emplace_back(vm::instruction::req, m_filename);
+  return vec;
 }
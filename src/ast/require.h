@@ -11,7 +11,8 @@ class require : public expression {
 public:
   require(const std::string& filename);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   std::string m_filename;
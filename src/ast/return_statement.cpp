@@ -1,5 +1,6 @@
 #include "return_statement.h"
 
+#include "resolver.h"
 #include "vm/instruction.h"
 
 using namespace vv;
@@ -8,7 +9,12 @@ ast::return_statement::return_statement(std::unique_ptr<expression>&& value)
   : m_value {move(value)}
 { }
 
-std::vector<vm::command> ast::return_statement::generate() const
+void ast::return_statement::resolve(resolver& res) const
+{
+  m_value->resolve(res);
+}
+
+vm::bytecode ast::return_statement::generate() const
 {
   auto vec = m_value->code();
   vec.emplace_back(vm::instruction::ret, false);
@@ -1,35 +1,62 @@
 #include "try_catch.h"
 
 #include "gc.h"
+#include "opt.h"
 
 using namespace vv;
 
 ast::try_catch::try_catch(std::unique_ptr<expression>&& body,
                           std::vector<catch_stmt>&& catchers)
-  : m_body     {move(body)},
-    m_catchers {move(catchers)}
+  : m_body            {move(body)},
+    m_catchers        {move(catchers)},
+    m_body_layout     {},
+    m_catcher_layouts (m_catchers.size()),
+    m_exception_vars  (m_catchers.size())
 { }
 
-std::vector<vm::command> ast::try_catch::generate() const
+void ast::try_catch::resolve(resolver& res) const
 {
-  std::vector<vm::command> vec;
+  for (size_t i{}; i != m_catchers.size(); ++i) {
+    res.enter_function(m_catcher_layouts[i]);
+    m_exception_vars[i] = res.declare(m_catchers[i].exception_name);
+    m_catchers[i].catcher->resolve(res);
+    res.leave();
+  }
+
+  res.enter_function(m_body_layout);
+  m_body->resolve(res);
+  res.leave();
+}
+
+vm::bytecode ast::try_catch::generate() const
+{
+  vm::bytecode vec;
 
-  for (const auto& i : m_catchers) {
-    std::vector<vm::command> catcher;
+  for (size_t i{}; i != m_catchers.size(); ++i) {
+    const auto& stmt = m_catchers[i];
+    vm::bytecode catcher;
     catcher.emplace_back(vm::instruction::arg, 0);
 
-    catcher.emplace_back(vm::instruction::let, i.exception_name);
-    const auto catcher_body = i.catcher->code();
-    copy(begin(catcher_body), end(catcher_body), back_inserter(catcher));
+    if (m_exception_vars[i])
+      catcher.emplace_back(vm::instruction::llet, *m_exception_vars[i]);
+    else
+      catcher.emplace_back(vm::instruction::let, stmt.exception_name);
+    const auto catcher_body = stmt.catcher->code();
+    catcher.append(catcher_body);
     catcher.emplace_back(vm::instruction::ret, false);
+    optimize(catcher);
 
-    vec.emplace_back(vm::instruction::pfn, vm::function_t{1, move(catcher)});
-    vec.emplace_back(vm::instruction::pushc, i.exception_type);
+    const auto locals = m_catcher_layouts[i].slots;
+    vec.emplace_back(vm::instruction::pfn,
+                     vm::function_t{1, std::move(catcher), false, locals});
+    vec.emplace_back(vm::instruction::pushc, stmt.exception_type);
   }
 
   auto body = m_body->code();
   body.emplace_back(vm::instruction::ret, false);
-  vec.emplace_back(vm::instruction::pfn, vm::function_t{0, move(body)});
+  optimize(body);
+  vec.emplace_back(vm::instruction::pfn,
+                   vm::function_t{0, std::move(body), false, m_body_layout.slots});
   vec.emplace_back(vm::instruction::call, 0);
 
   for (const auto& i : m_catchers)
@@ -2,6 +2,7 @@
 #define VV_AST_TRY_CATCH_H
 
 #include "expression.h"
+#include "resolver.h"
 
 namespace vv {
 
@@ -18,11 +19,17 @@ public:
   try_catch(std::unique_ptr<expression>&& body,
             std::vector<catch_stmt>&& catchers);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   std::unique_ptr<expression> m_body;
   std::vector<catch_stmt> m_catchers;
+
+  // The body and each catcher are run as separate functions
+  mutable scope_layout m_body_layout;
+  mutable std::vector<scope_layout> m_catcher_layouts;
+  mutable std::vector<boost::optional<vm::local_variable>> m_exception_vars;
 };
 
 }
@@ -1,6 +1,7 @@
 #include "type_definition.h"
 
 #include "gc.h"
+#include "resolver.h"
 #include "vm/instruction.h"
 
 using namespace vv;
@@ -15,13 +16,19 @@ ast::type_definition::type_definition(
     m_methods {move(methods)}
 { }
 
-std::vector<vm::command> ast::type_definition::generate() const
+void ast::type_definition::resolve(resolver& res) const
 {
-  std::vector<vm::command> vec;
+  for (const auto& i : m_methods)
+    i.second.resolve(res);
+  res.declare_dynamic(m_name);
+}
+
+vm::bytecode ast::type_definition::generate() const
+{
+  vm::bytecode vec;
   for (const auto& i : m_methods) {
-    // the code returned is guaranteed atm to be a single pfn instruction, so
-    // just use it directly instead of copying the vector
-    vec.push_back(std::move(i.second.code().front()));
+    // the code returned is guaranteed atm to be a single pfn instruction
+    vec.append(i.second.code());
     vec.emplace_back( vm::instruction::psym, i.first );
   }
 
@@ -22,7 +22,8 @@ public:
                     m_methods);
 
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   symbol m_name;
@@ -6,9 +6,20 @@ using namespace vv;
 
 ast::variable::variable(symbol name) : m_name{name} { }
 
-std::vector<vm::command> ast::variable::generate() const
+void ast::variable::resolve(resolver& res) const
+{
+  if (m_name != symbol{"self"})
+    m_var = res.lookup(m_name);
+}
+
+vm::bytecode ast::variable::generate() const
 {
   if (m_name == symbol{"self"})
     return { {vm::instruction::self} };
+  if (m_var) {
+    vm::bytecode vec;
+    vec.emplace_back(vm::instruction::lread, *m_var);
+    return vec;
+  }
   return { {vm::instruction::read, m_name} };
 }
@@ -2,6 +2,7 @@
 #define VV_AST_VARIABLE_H
 
 #include "expression.h"
+#include "resolver.h"
 
 #include "symbol.h"
 
@@ -13,10 +14,13 @@ class variable : public expression {
 public:
   variable(symbol name);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   symbol m_name;
+  mutable boost::optional<vm::local_variable> m_var;
+
 };
 
 }
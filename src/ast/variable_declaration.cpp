@@ -11,9 +11,18 @@ ast::variable_declaration::variable_declaration(
     m_value {move(value)}
 { }
 
-std::vector<vm::command> ast::variable_declaration::generate() const
+void ast::variable_declaration::resolve(resolver& res) const
+{
+  m_value->resolve(res);
+  m_var = res.declare(m_name);
+}
+
+vm::bytecode ast::variable_declaration::generate() const
 {
   auto vec = m_value->code();
-  vec.emplace_back(vm::instruction::let, m_name);
+  if (m_var)
+    vec.emplace_back(vm::instruction::llet, *m_var);
+  else
+    vec.emplace_back(vm::instruction::let, m_name);
   return vec;
 }
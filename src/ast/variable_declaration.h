@@ -2,6 +2,7 @@
 #define VV_AST_VARIABLE_DECLARATION_H
 
 #include "expression.h"
+#include "resolver.h"
 
 #include "symbol.h"
 
@@ -13,11 +14,14 @@ class variable_declaration : public expression {
 public:
   variable_declaration(symbol name, std::unique_ptr<expression>&& value);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   symbol m_name;
   std::unique_ptr<expression> m_value;
+  mutable boost::optional<vm::local_variable> m_var;
+
 };
 
 }
@@ -1,5 +1,6 @@
 #include "while_loop.h"
 
+#include "resolver.h"
 #include "value.h"
 #include "vm/instruction.h"
 
@@ -11,7 +12,13 @@ ast::while_loop::while_loop(std::unique_ptr<expression>&& test,
     m_body {move(body)}
 { }
 
-std::vector<vm::command> ast::while_loop::generate() const
+void ast::while_loop::resolve(resolver& res) const
+{
+  m_test->resolve(res);
+  m_body->resolve(res);
+}
+
+vm::bytecode ast::while_loop::generate() const
 {
   auto vec = m_test->code();
 
@@ -19,14 +26,12 @@ std::vector<vm::command> ast::while_loop::generate() const
   vec.emplace_back(vm::instruction::jf);
   vec.emplace_back(vm::instruction::pop, 1); //test result
 
-  const auto body = m_body->code();
-  for (auto&& i : body)
-    vec.push_back(std::move(i));
+  vec.append(m_body->code());
 
   vec.emplace_back(vm::instruction::pop, 1); // expr result
   vec.emplace_back(vm::instruction::jmp, -static_cast<value::integer>(vec.size() + 1));
 
-  vec[test_idx].arg = static_cast<value::integer>(vec.size() - test_idx) - 1;
+  vec[test_idx].arg = static_cast<int32_t>(vec.size() - test_idx) - 1;
   vec.emplace_back(vm::instruction::pop, 1); // failed test
   vec.emplace_back(vm::instruction::pnil);
 
@@ -12,7 +12,8 @@ public:
   while_loop(std::unique_ptr<expression>&& test,
              std::unique_ptr<expression>&& body);
 
-  std::vector<vm::command> generate() const override;
+  vm::bytecode generate() const override;
+  void resolve(resolver& res) const override;
 
 private:
   std::unique_ptr<expression> m_test;
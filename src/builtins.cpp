@@ -1,6 +1,8 @@
 #include "builtins.h"
 
 #include "c_internal.h"
+#include "gc.h"
+#include "output.h"
 #include "builtins/array.h"
 #include "builtins/character.h"
 #include "builtins/dictionary.h"
@@ -21,7 +23,9 @@
 #include "value/dictionary.h"
 #include "value/exception.h"
 #include "value/file.h"
+#include "value/floating_point.h"
 #include "value/function.h"
+#include "value/method.h"
 #include "value/object.h"
 #include "value/opt_functions.h"
 #include "value/range.h"
@@ -29,7 +33,11 @@
 #include "value/string.h"
 #include "value/type.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <numeric>
+#include <string_view>
 
 using namespace vv;
 using namespace builtin;
@@ -84,85 +92,220 @@ call_result call_method(vm::machine& vm,
   return { true, val };
 }
 
-template <typename F>
-call_result fake_for_loop(vm::machine& vm, const F& inner)
-{
-  // Get iterator from range
-  vm.arg(0);
-  const auto range = vm.top();
-  auto iter = call_method(vm, range, sym::start).value;
+// The items of a range, one at a time. Arrays and Ranges of Integers are
+// iterated over directly, instead of going through the VM for every item;
+// everything else is iterated over as in a for loop, with the iterator pushed
+// onto the stack (so it isn't collected) when it's created.
+class range_items {
+public:
+  range_items(vm::machine& vm, gc::managed_ptr range)
+    : m_vm      {vm},
+      m_range   {range},
+      m_kind    {kind::iterator},
+      m_idx     {0},
+      m_end     {0},
+      m_iter    {},
+      m_started {false}
+  {
+    if (range.type() == builtin::type::array) {
+      m_kind = kind::array;
+      return;
+    }
+    if (range.type() == builtin::type::range) {
+      const auto& rng = value::get<value::range>(range);
+      if (rng.start.tag() == tag::integer && rng.end.tag() == tag::integer) {
+        m_kind = kind::integers;
+        m_idx = value::get<value::integer>(rng.start);
+        m_end = value::get<value::integer>(rng.end);
+        return;
+      }
+    }
+    m_iter = call_method(vm, range, sym::start).value;
+  }
 
-  vm.arg(1);
-  const auto supplied_fn = vm.top();
+  // Sets item to the next item, returning false instead if there aren't any.
+  bool next(gc::managed_ptr& item)
+  {
+    switch (m_kind) {
+    case kind::array: {
+      // Checked every time, since the Array might be modified along the way
+      const auto& arr = value::get<value::array>(m_range);
+      if (static_cast<size_t>(m_idx) >= arr.size())
+        return false;
+      item = arr[static_cast<size_t>(m_idx++)];
+      return true;
+    }
 
-  for (;;) {
-    vm.push(iter);
-    vm.opt_at_end();
-    const auto at_end = vm.top();
-    vm.pop(1);
-    if (truthy(at_end)) {
-      return { true, at_end };
+    case kind::integers:
+      if (m_idx >= m_end)
+        return false;
+      item = gc::alloc<value::integer>( m_idx++ );
+      return true;
+
+    case kind::iterator:
+      if (m_started) {
+        m_vm.push(m_iter);
+        m_vm.opt_incr();
+        m_vm.pop(1);
+      }
+      m_started = true;
+
+      m_vm.push(m_iter);
+      m_vm.opt_at_end();
+      const auto at_end = truthy(m_vm.top());
+      m_vm.pop(1);
+      if (at_end)
+        return false;
+
+      m_vm.push(m_iter);
+      m_vm.opt_get();
+      item = m_vm.top();
+      m_vm.pop(1);
+      return true;
     }
+    return false;
+  }
 
-    vm.push(iter);
-    vm.opt_get();
-    const auto next_item = vm.top();
-    vm.pop(1);
+private:
+  enum class kind { array, integers, iterator };
+
+  vm::machine& m_vm;
+  gc::managed_ptr m_range;
+  kind m_kind;
+  // Index into an Array, or the next Integer in a Range
+  value::integer m_idx;
+  value::integer m_end;
+  gc::managed_ptr m_iter;
+  bool m_started;
+};
 
-    const auto res = inner(vm, supplied_fn, next_item);
-    if (res.completed) {
-      vm.pop(1); // iter
-      return res;
+// A function called over and over with the same number of arguments, as by map
+// or reduce. Builtin methods (like 1.add) are called directly, without a call
+// frame, and Vivaldi functions through a call frame that's only built once;
+// anything else is called normally.
+class repeated_call {
+public:
+  repeated_call(vm::machine& vm, gc::managed_ptr func, value::integer argc)
+    : m_vm       {vm},
+      m_func     {func},
+      m_argc     {argc},
+      m_prepared {vm.prepare_call(func, argc)},
+      m_binop    {}
+  {
+    if (func.tag() == tag::method && argc == 1) {
+      const auto inner = value::get<value::method>(func).function;
+      if (inner.tag() == tag::opt_binop)
+        m_binop = inner;
     }
+  }
 
-    vm.push(iter);
-    vm.opt_incr();
-    vm.pop(1);
+  // Calls the function with the argc arguments on top of the stack, replacing
+  // them with the result.
+  void operator()()
+  {
+    if (m_binop) {
+      // Leave the argument on the stack, so it stays rooted while the body runs
+      const auto self = value::get<value::method>(m_func).self;
+      const auto res = value::get<value::opt_binop>(m_binop).body(self,
+                                                                  m_vm.top());
+      m_vm.pop(1);
+      m_vm.push(res);
+    }
+    else if (m_prepared) {
+      m_vm.call_prepared(*m_prepared);
+    }
+    else {
+      m_vm.push(m_func);
+      m_vm.call(m_argc);
+      m_vm.run_cur_scope();
+    }
   }
-}
 
+private:
+  vm::machine& m_vm;
+  gc::managed_ptr m_func;
+  value::integer m_argc;
+  boost::optional<vm::call_frame> m_prepared;
+  gc::managed_ptr m_binop;
+};
+
+// Calls inner(item, transform(item)) for each item in the range passed as the
+// first argument, where transform is the function passed as the second, until
+// inner returns true.
 template <typename F>
-call_result transformed_range(vm::machine& vm, const F& inner)
+void transformed_range(vm::machine& vm, const F& inner)
 {
-  return fake_for_loop(vm, [&](auto& vm, const auto transform, const auto orig)
-  {
-    vm.push(orig);
-
-    vm.push(transform);
-    vm.call(1);
-    vm.run_cur_scope();
+  vm.arg(0);
+  const auto range = vm.top();
+  vm.arg(1);
+  repeated_call transform{vm, vm.top(), 1};
 
-    const auto completed = inner(orig, vm.top());
-    return call_result{ completed, vm.top() };
-  });
+  range_items items{vm, range};
+  gc::managed_ptr orig;
+  while (items.next(orig)) {
+    vm.push(orig);
+    transform();
+    const auto done = inner(orig, vm.top());
+    vm.pop(1);
+    if (done)
+      return;
+  }
 }
 
 // }}}
 // I/O {{{
 
-gc::managed_ptr fn_print(vm::machine& vm)
+void write_value(gc::managed_ptr arg, vm::machine& vm)
 {
-  vm.arg(0);
-  const auto arg = vm.top();
   if (arg.tag() == tag::string)
-    std::cout << value::get<value::string>(arg);
+    output::write(value::get<value::string>(arg));
   else if (arg.tag() == tag::character)
-    std::cout << value::get<value::character>(arg);
+    output::write(value::get<value::character>(arg));
   else
-    std::cout << pretty_print(arg, vm);
+    output::write(pretty_print(arg, vm));
+}
 
+gc::managed_ptr fn_print(vm::machine& vm)
+{
+  vm.arg(0);
+  write_value(vm.top(), vm);
   return gc::alloc<value::nil>( );
 }
 
 gc::managed_ptr fn_puts(vm::machine& vm)
 {
-  const auto ret = fn_print(vm);
-  std::cout << '\n';
-  return ret;
+  vm.arg(0);
+  write_value(vm.top(), vm);
+  output::write('\n');
+  return gc::alloc<value::nil>( );
+}
+
+gc::managed_ptr fn_print_lines(vm::machine& vm)
+{
+  vm.arg(0);
+  const auto arr = vm.top();
+  if (arr.tag() != tag::array)
+    return throw_exception(type::type_error, "print_lines can only print Arrays");
+
+  // Indexed, since printing an object can call its str() method, which could
+  // modify the Array
+  for (size_t i = 0; i < value::get<value::array>(arr).size(); ++i) {
+    write_value(value::get<value::array>(arr)[i], vm);
+    output::write('\n');
+  }
+  return gc::alloc<value::nil>( );
+}
+
+gc::managed_ptr fn_flush(vm::machine&)
+{
+  output::flush();
+  return gc::alloc<value::nil>( );
 }
 
 gc::managed_ptr fn_gets(vm::machine&)
 {
+  // Make sure any prompt's been printed
+  output::flush();
   std::string str;
   getline(std::cin, str);
 
@@ -179,8 +322,10 @@ gc::managed_ptr fn_filter(vm::machine& vm)
 
   transformed_range(vm, [array](const auto item, const auto pred)
   {
-    if (truthy(pred))
+    if (truthy(pred)) {
       value::get<value::array>(array).push_back(item);
+      gc::write_barrier(array);
+    }
     return false;
   });
 
@@ -203,6 +348,7 @@ gc::managed_ptr fn_map(vm::machine& vm)
   transformed_range(vm, [mapped](const auto, const auto val)
   {
     value::get<value::array>(mapped).push_back(val);
+    gc::write_barrier(mapped);
     return false;
   });
 
@@ -236,100 +382,174 @@ gc::managed_ptr fn_any(vm::machine& vm)
 
 gc::managed_ptr fn_reduce(vm::machine& vm)
 {
-  // Get iterator from range
   vm.arg(0);
   const auto range = vm.top();
-  vm.pop(1);
-  const auto iter = call_method(vm, range, sym::start).value;
-  vm.push(iter);
+  vm.arg(2);
+  repeated_call combine{vm, vm.top(), 2};
 
-  vm.arg(1); // put total on stack
+  range_items items{vm, range};
+  // The running total's kept on top of the stack
+  vm.arg(1);
+  gc::managed_ptr item;
+  while (items.next(item)) {
+    const auto total = vm.top();
+    vm.push(item);
+    vm.push(total);
+    combine();
+    const auto new_total = vm.top();
+    vm.pop(2);
+    vm.push(new_total);
+  }
+  return vm.top();
+}
 
+// Returns the order keys would be in if sorted, as indices into keys, with
+// ties broken by index.
+template <typename F>
+std::vector<size_t> native_order(const std::vector<gc::managed_ptr>& keys,
+                                 const F& native_key)
+{
+  std::vector<std::pair<decltype(native_key(keys.front())), size_t>> pairs;
+  pairs.reserve(keys.size());
+  for (size_t i = 0; i != keys.size(); ++i)
+    pairs.emplace_back(native_key(keys[i]), i);
+  std::sort(begin(pairs), end(pairs));
+
+  std::vector<size_t> order;
+  order.reserve(keys.size());
+  for (const auto& i : pairs)
+    order.push_back(i.second);
+  return order;
+}
 
-  for (;;) {
-    vm.push(iter);
-    vm.opt_at_end();
-    const auto at_end = vm.top();
-    vm.pop(1);
-    if (truthy(at_end)) {
-      return vm.top();
-    }
+// Returns the order keys would be in if sorted, as indices into keys. If every
+// key is an Integer, a Float or a String (all the same type), they're compared
+// natively, and the sort's always stable; otherwise they're compared by calling
+// 'less' on them.
+std::vector<size_t> sorted_order(vm::machine& vm,
+                                 const std::vector<gc::managed_ptr>& keys,
+                                 const bool stable)
+{
+  const auto type = keys.empty() ? gc::managed_ptr{} : keys.front().type();
+  const auto homogeneous = all_of(begin(keys), end(keys),
+                                  [type](auto i) { return i.type() == type; });
 
-    auto total = vm.top();
-    vm.push(iter);
-    vm.opt_get();
-    const auto next_item = vm.top();
-    vm.pop(1);
-    vm.push(next_item);
-    vm.push(total);
+  if (homogeneous && type == builtin::type::integer) {
+    return native_order(keys, [](auto i) { return value::get<value::integer>(i); });
+  }
+  if (homogeneous && type == builtin::type::floating_point) {
+    // NaNs go last, so there's still a strict weak ordering
+    return native_order(keys, [](auto i)
+    {
+      const auto flt = value::get<value::floating_point>(i);
+      return std::make_pair(std::isnan(flt), std::isnan(flt) ? 0.0 : flt);
+    });
+  }
+  if (homogeneous && type == builtin::type::string) {
+    return native_order(keys, [](auto i)
+                              { return std::string_view{value::get<value::string>(i)}; });
+  }
 
-    vm.arg(2); // supplied function
-    vm.call(2);
+  // Indices are sorted, rather than the keys themselves, since calling 'less'
+  // can trigger a collection, and the keys are only safe while they're where
+  // the caller's keeping them
+  std::vector<size_t> order(keys.size());
+  iota(begin(order), end(order), size_t{0});
+  const auto less = [&](const size_t left, const size_t right)
+  {
+    vm.push(keys[right]);
+    vm.push(keys[left]);
+    vm.opt_tmpm(sym::less);
+    vm.call(1);
     vm.run_cur_scope();
-
-    // replace old total with new
-    total = vm.top();
-    vm.pop(2); // new total, orig total
-    vm.push(total);
-
-    vm.push(iter);
-    vm.opt_incr();
+    const auto res = truthy(vm.top());
     vm.pop(1);
-  }
+    return res;
+  };
+  if (stable)
+    std::stable_sort(begin(order), end(order), less);
+  else
+    std::sort(begin(order), end(order), less);
+  return order;
 }
 
-gc::managed_ptr fn_sort(vm::machine& vm)
+// Rearranges the members of arr into the given order.
+void reorder(gc::managed_ptr arr, const std::vector<size_t>& order)
+{
+  auto& items = value::get<value::array>(arr);
+  std::vector<gc::managed_ptr> sorted;
+  sorted.reserve(items.size());
+  for (const auto i : order)
+    sorted.push_back(items[i]);
+  items = std::move(sorted);
+  gc::write_barrier(arr);
+}
+
+// Sorts the members of the range passed as the first argument.
+gc::managed_ptr sort_range(vm::machine& vm, const bool stable)
 {
   vm.parr(0);
   const auto array = vm.top();
 
   vm.arg(0);
   const auto range = vm.top();
-  vm.pop(1);
 
   // If range is an Array, we can just copy it; otherwise we need to do it
   // through the VM
   if (range.type() == builtin::type::array) {
     value::get<value::array>(array) = value::get<value::array>(range);
+    gc::write_barrier(array);
   }
   else {
-    const auto iter = call_method(vm, range, sym::start).value;
-    vm.push(iter);
-
-    for (;;) {
-      vm.push(iter);
-      vm.opt_at_end();
-      const auto at_end = vm.top();
-      vm.pop(1);
-      if (truthy(at_end))
-        break;
-
-      vm.push(iter);
-      vm.opt_get();
-      const auto next_item = vm.top();
-      vm.pop(1);
-      value::get<value::array>(array).push_back(next_item);
-
-      vm.push(iter);
-      vm.opt_incr();
-      vm.pop(1);
+    range_items items{vm, range};
+    gc::managed_ptr item;
+    while (items.next(item)) {
+      value::get<value::array>(array).push_back(item);
+      gc::write_barrier(array);
     }
   }
 
-  std::sort(begin(value::get<value::array>(array)),
-            end(value::get<value::array>(array)),
-            [&](auto left, auto right)
-  {
-    vm.push(right);
-    vm.push(left);
-    vm.opt_tmpm(sym::less);
-    vm.call(1);
-    vm.run_cur_scope();
-    const auto res = vm.top();
+  reorder(array, sorted_order(vm, value::get<value::array>(array), stable));
+  return array;
+}
+
+gc::managed_ptr fn_sort(vm::machine& vm)
+{
+  return sort_range(vm, false);
+}
+
+gc::managed_ptr fn_stable_sort(vm::machine& vm)
+{
+  return sort_range(vm, true);
+}
+
+gc::managed_ptr fn_sort_by(vm::machine& vm)
+{
+  vm.parr(0);
+  const auto array = vm.top();
+  vm.parr(0);
+  const auto keys = vm.top();
+
+  vm.arg(0);
+  const auto range = vm.top();
+  vm.arg(1);
+  repeated_call key_of{vm, vm.top(), 1};
+
+  // Each item's key is only computed once, up front
+  range_items items{vm, range};
+  gc::managed_ptr item;
+  while (items.next(item)) {
+    value::get<value::array>(array).push_back(item);
+    gc::write_barrier(array);
+
+    vm.push(item);
+    key_of();
+    value::get<value::array>(keys).push_back(vm.top());
+    gc::write_barrier(keys);
     vm.pop(1);
-    return truthy(res);
-  });
+  }
 
+  reorder(array, sorted_order(vm, value::get<value::array>(keys), true));
   return array;
 }
 
@@ -376,6 +596,7 @@ gc::managed_ptr fn_reverse(vm::machine& vm)
     const auto next_item = vm.top();
     vm.pop(1);
     value::get<value::array>(arr).push_back(next_item);
+    gc::write_barrier(arr);
 
     vm.push(iter);
     vm.opt_incr();
@@ -390,11 +611,15 @@ gc::managed_ptr fn_reverse(vm::machine& vm)
 gc::managed_ptr function::print;
 gc::managed_ptr function::puts;
 gc::managed_ptr function::gets;
+gc::managed_ptr function::print_lines;
+gc::managed_ptr function::flush;
 
 gc::managed_ptr function::filter;
 gc::managed_ptr function::map;
 gc::managed_ptr function::reduce;
 gc::managed_ptr function::sort;
+gc::managed_ptr function::stable_sort;
+gc::managed_ptr function::sort_by;
 gc::managed_ptr function::all;
 gc::managed_ptr function::any;
 gc::managed_ptr function::count;
@@ -707,8 +932,8 @@ void init_function()
   // constructor references builtin::type::function.
   const auto bind = gc::alloc<value::opt_binop>( function::bind );
   const auto apply = gc::alloc<value::builtin_function>( function::apply, size_t{1} );
-  value::get<value::type>(builtin::type::function).methods[{"bind"}] = bind;
-  value::get<value::type>(builtin::type::function).methods[{"apply"}] = apply;
+  set_method(builtin::type::function, {"bind"}, bind);
+  set_method(builtin::type::function, {"apply"}, apply);
 
 }
 
@@ -1059,11 +1284,15 @@ void builtin::init()
   function::print = gc::alloc<value::builtin_function>( fn_print, size_t{1} );
   function::puts = gc::alloc<value::builtin_function>( fn_puts, size_t{1} );
   function::gets = gc::alloc<value::builtin_function>( fn_gets, size_t{0} );
+  function::print_lines = gc::alloc<value::builtin_function>( fn_print_lines, size_t{1} );
+  function::flush = gc::alloc<value::builtin_function>( fn_flush, size_t{0} );
 
   function::filter = gc::alloc<value::builtin_function>( fn_filter, size_t{2} );
   function::map = gc::alloc<value::builtin_function>( fn_map, size_t{2} );
   function::reduce = gc::alloc<value::builtin_function>( fn_reduce, size_t{3} );
   function::sort = gc::alloc<value::builtin_function>( fn_sort, size_t{1} );
+  function::stable_sort = gc::alloc<value::builtin_function>( fn_stable_sort, size_t{1} );
+  function::sort_by = gc::alloc<value::builtin_function>( fn_sort_by, size_t{2} );
   function::all = gc::alloc<value::builtin_function>( fn_all, size_t{2} );
   function::any = gc::alloc<value::builtin_function>( fn_any, size_t{2} );
   function::count = gc::alloc<value::builtin_function>( fn_count, size_t{2} );
@@ -1099,11 +1328,15 @@ void builtin::make_base_env(gc::managed_ptr base)
     { {"print"},               builtin::function::print },
     { {"puts"},                builtin::function::puts },
     { {"gets"},                builtin::function::gets },
+    { {"print_lines"},         builtin::function::print_lines },
+    { {"flush"},               builtin::function::flush },
     { {"count"},               builtin::function::count },
     { {"filter"},              builtin::function::filter },
     { {"map"},                 builtin::function::map },
     { {"reduce"},              builtin::function::reduce },
     { {"sort"},                builtin::function::sort },
+    { {"stable_sort"},         builtin::function::stable_sort },
+    { {"sort_by"},             builtin::function::sort_by },
     { {"any"},                 builtin::function::any },
     { {"all"},                 builtin::function::all },
     { {"quit"},                builtin::function::quit },
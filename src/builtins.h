@@ -53,11 +53,15 @@ namespace function {
 extern gc::managed_ptr print;
 extern gc::managed_ptr puts;
 extern gc::managed_ptr gets;
+extern gc::managed_ptr print_lines;
+extern gc::managed_ptr flush;
 
 extern gc::managed_ptr filter;
 extern gc::managed_ptr map;
 extern gc::managed_ptr reduce;
 extern gc::managed_ptr sort;
+extern gc::managed_ptr stable_sort;
+extern gc::managed_ptr sort_by;
 extern gc::managed_ptr all;
 extern gc::managed_ptr any;
 extern gc::managed_ptr count;
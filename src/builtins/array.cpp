@@ -1,6 +1,7 @@
 #include "builtins/array.h"
 
 #include "builtins.h"
+#include "gc.h"
 #include "messages.h"
 #include "gc/alloc.h"
 #include "utils/lang.h"
@@ -20,6 +21,7 @@ gc::managed_ptr array::init(gc::managed_ptr self, gc::managed_ptr arg)
                                                     type::array,
                                                     arg.type()));
   value::get<value::array>(self) = value::get<value::array>(arg);
+  gc::write_barrier(self);
   return self;
 }
 
@@ -32,6 +34,7 @@ gc::managed_ptr array::size(gc::managed_ptr self)
 gc::managed_ptr array::append(gc::managed_ptr self, gc::managed_ptr arg)
 {
   value::get<value::array>(self).push_back(arg);
+  gc::write_barrier(self);
   return self;
 }
 
@@ -73,13 +76,15 @@ gc::managed_ptr array::set_at(vm::machine& vm)
   const auto val = value::get<value::integer>(arg);
 
   vm.self();
-  auto& arr = value::get<value::array>(vm.top());
+  const auto self = vm.top();
+  auto& arr = value::get<value::array>(self);
 
   if (arr.size() <= static_cast<unsigned>(val) || val < 0)
     return throw_exception(type::range_error,
                            message::out_of_range(0, arr.size(), val));
 
   vm.arg(1);
+  gc::write_barrier(self);
   return arr[static_cast<unsigned>(val)] = vm.top();
 }
 
@@ -125,12 +130,13 @@ gc::managed_ptr array::equals(vm::machine& vm)
   const auto& arr1 = value::get<value::array>(self);
   const auto& arr2 = value::get<value::array>(arg);
 
+  static vm::method_cache equals_cache;
   auto eq = std::equal(begin(arr1), end(arr1), begin(arr2), end(arr2),
                        [&](auto first, auto second)
   {
     vm.push(second);
     vm.push(first);
-    vm.opt_tmpm(sym::equals);
+    vm.opt_tmpm(sym::equals, equals_cache);
     vm.call(1);
     vm.run_cur_scope();
     auto res = vm.top();
@@ -1,6 +1,7 @@
 #include "builtins/dictionary.h"
 
 #include "builtins.h"
+#include "gc.h"
 #include "gc/alloc.h"
 #include "messages.h"
 #include "utils/lang.h"
@@ -18,6 +19,7 @@ gc::managed_ptr dictionary::init(gc::managed_ptr self, gc::managed_ptr arg)
                                                     arg.type()));
   }
   value::get<value::dictionary>(self) = value::get<value::dictionary>(arg);
+  gc::write_barrier(self);
   return self;
 }
 
@@ -31,7 +33,7 @@ gc::managed_ptr dictionary::at(gc::managed_ptr self, gc::managed_ptr arg)
 {
   auto& dict = value::get<value::dictionary>(self);
   const auto& mem = dict.find(arg);
-  if (mem == end(dict))
+  if (mem == std::end(dict))
     return gc::alloc<value::nil>( );
   return mem->second;
 }
@@ -39,9 +41,11 @@ gc::managed_ptr dictionary::at(gc::managed_ptr self, gc::managed_ptr arg)
 gc::managed_ptr dictionary::set_at(vm::machine& vm)
 {
   vm.self();
-  auto& dict = value::get<value::dictionary>(vm.top());
+  const auto self = vm.top();
+  auto& dict = value::get<value::dictionary>(self);
   vm.arg(0);
   const auto arg = vm.top();
   vm.arg(1);
+  gc::write_barrier(self);
   return dict[arg] = vm.top();
 }
@@ -7,8 +7,6 @@
 #include "value/file.h"
 #include "value/string.h"
 
-#include <sstream>
-
 using namespace vv;
 using namespace builtin;
 
@@ -22,25 +20,18 @@ gc::managed_ptr file::init(gc::managed_ptr self, gc::managed_ptr arg)
 
   const auto& filename = value::get<value::string>(arg);
 
-  value::get<value::file>(self).val = std::fstream{filename};
-  if (!value::get<value::file>(self).val) {
+  auto& file = value::get<value::file>(self);
+  file = value::file::value_type{filename};
+  if (!file.is_open()) {
     return throw_exception(type::file_not_found_error,
                            "Error opening file \"" + filename + '"');
   }
-  value::get<value::file>(self).name = filename;
-  std::getline(value::get<value::file>(self).val,
-               value::get<value::file>(self).cur_line);
   return self;
 }
 
 gc::managed_ptr file::contents(gc::managed_ptr self)
 {
-  auto& file = value::get<value::file>(self);
-  std::ostringstream str_stream;
-  str_stream << file.cur_line;
-  str_stream << file.val.rdbuf();
-  file.cur_line.clear();
-  return gc::alloc<value::string>( str_stream.str() );
+  return gc::alloc<value::string>( value::get<value::file>(self).rest() );
 }
 
 gc::managed_ptr file::start(gc::managed_ptr self)
@@ -50,26 +41,20 @@ gc::managed_ptr file::start(gc::managed_ptr self)
 
 gc::managed_ptr file::get(gc::managed_ptr self)
 {
-  const auto& file = value::get<value::file>(self);
-  return gc::alloc<value::string>( file.cur_line );
+  const auto line = value::get<value::file>(self).line();
+  return gc::alloc<value::string>( std::string{begin(line), end(line)} );
 }
 
 gc::managed_ptr file::increment(gc::managed_ptr self)
 {
   auto& file = value::get<value::file>(self);
-  if (file.val.peek() == EOF) {
-    if (file.cur_line.empty())
-      return throw_exception(type::range_error,
-                             message::iterator_at_end(type::file));
-    file.cur_line.clear();
-    return self;
-  }
-  std::getline(file.val, file.cur_line);
+  if (file.at_end())
+    return throw_exception(type::range_error, message::iterator_at_end(type::file));
+  file.next();
   return self;
 }
 
 gc::managed_ptr file::at_end(gc::managed_ptr self)
 {
-  auto& file = value::get<value::file>(self);
-  return gc::alloc<value::boolean>(file.val.peek() == EOF && !file.cur_line.size());
+  return gc::alloc<value::boolean>( value::get<value::file>(self).at_end() );
 }
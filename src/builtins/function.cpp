@@ -19,7 +19,7 @@ size_t get_argc(gc::managed_ptr fn)
   case tag::opt_monop:        return 0;
   case tag::opt_binop:        return 1;
   case tag::builtin_function: return value::get<value::builtin_function>(fn).argc;
-  case tag::function:         return value::get<value::function>(fn).argc;
+  case tag::function:         return value::get<value::function>(fn).prototype->argc;
   default: return get_argc(value::get<value::partial_function>(fn).function) + 1;
   }
 }
@@ -28,7 +28,7 @@ bool takes_varargs(gc::managed_ptr fn)
 {
   switch (fn.tag()) {
   case tag::builtin_function: return value::get<value::builtin_function>(fn).takes_varargs;
-  case tag::function:         return value::get<value::function>(fn).takes_varargs;
+  case tag::function:         return value::get<value::function>(fn).prototype->takes_varargs;
   default:                    return false;
   }
 }
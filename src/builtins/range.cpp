@@ -1,6 +1,7 @@
 #include "builtins/range.h"
 
 #include "builtins.h"
+#include "gc.h"
 #include "gc/alloc.h"
 #include "utils/lang.h"
 #include "value/array.h"
@@ -20,6 +21,7 @@ gc::managed_ptr range::init(vm::machine& vm)
   value::get<value::range>(rng).end = vm.top();
   vm.arg(0);
   value::get<value::range>(rng).start = vm.top();
+  gc::write_barrier(rng);
   return rng;
 }
 
@@ -44,7 +46,8 @@ gc::managed_ptr range::at_end(vm::machine& vm)
   auto& rng = value::get<value::range>(vm.top());
   vm.push(rng.start);
   vm.push(rng.end);
-  vm.opt_tmpm(sym::greater);
+  static vm::method_cache greater_cache;
+  vm.opt_tmpm(sym::greater, greater_cache);
   vm.call(1);
   vm.run_cur_scope();
   vm.opt_not();
@@ -64,6 +67,7 @@ gc::managed_ptr range::increment(vm::machine& vm)
   vm.push(value::get<value::range>(rng).start);
   vm.opt_add();
   value::get<value::range>(rng).start = vm.top();
+  gc::write_barrier(rng);
   return rng;
 }
 
@@ -74,10 +78,11 @@ gc::managed_ptr range::to_arr(vm::machine& vm)
   vm.push(rng.start);
   auto iter = vm.top();
   int count{};
+  static vm::method_cache greater_cache;
   for (;;) {
     vm.dup();
     vm.push(rng.end);
-    vm.opt_tmpm(sym::greater);
+    vm.opt_tmpm(sym::greater, greater_cache);
     vm.call(1);
     vm.run_cur_scope();
     if (!truthy(vm.top()))
@@ -62,11 +62,11 @@ gc::managed_ptr regex::match(gc::managed_ptr self, gc::managed_ptr arg)
                            "Regexes can only be matched against Strings");
   }
 
-  const auto& regex = value::get<value::regex>(self).val;
+  const auto& regex = *value::get<value::regex>(self).val;
   const auto& str = value::get<value::string>(arg);
 
   std::smatch results;
-  regex_search(str, results, regex);
+  regex.search(str, results);
 
   return gc::alloc<value::regex_result>( arg, std::move(results) );
 }
@@ -78,14 +78,14 @@ gc::managed_ptr regex::match_index(gc::managed_ptr self, gc::managed_ptr arg)
                            "Regexes can only be matched against Strings");
   }
 
-  const auto& regex = value::get<value::regex>(self).val;
+  const auto& regex = *value::get<value::regex>(self).val;
   const auto& str = value::get<value::string>(arg);
 
   std::smatch results;
-  auto matched = regex_search(str, results, regex);
-  if (!matched)
+  if (!regex.search(str, results))
     return gc::alloc<value::nil>( );
-  return gc::alloc<value::integer>( static_cast<value::integer>(results.position()) );
+  const auto pos = results[0].first - begin(str);
+  return gc::alloc<value::integer>( static_cast<value::integer>(pos) );
 }
 
 // regex_result
@@ -100,7 +100,9 @@ gc::managed_ptr regex_result::at(gc::managed_ptr self, gc::managed_ptr arg)
 gc::managed_ptr regex_result::index(gc::managed_ptr self, gc::managed_ptr arg)
 {
   auto res = get_match_idx(self, arg);
-  return gc::alloc<value::integer>( static_cast<value::integer>(res.first.position(res.second)) );
+  const auto owner = value::get<value::regex_result>(self).owning_str;
+  const auto pos = res.first[res.second].first - begin(value::get<value::string>(owner));
+  return gc::alloc<value::integer>( static_cast<value::integer>(pos) );
 }
 
 gc::managed_ptr regex_result::size(gc::managed_ptr self)
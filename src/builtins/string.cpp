@@ -17,6 +17,18 @@ using namespace builtin;
 
 namespace {
 
+// Strings shorter than this are copied outright when they're appended to
+// something, rather than being referred to by a rope node (see value::string).
+const size_t min_rope_length = 64;
+
+gc::managed_ptr concatenate(gc::managed_ptr self, const std::string& suffix)
+{
+  const auto& str = *static_cast<value::string*>(self.get());
+  if (value::size_of(str) + suffix.size() < min_rope_length)
+    return gc::alloc<value::string>( value::get<value::string>(self) + suffix );
+  return gc::alloc<value::string>( self, gc::managed_ptr{}, suffix );
+}
+
 template <typename F>
 auto fn_string_cmp(const F& cmp)
 {
@@ -51,6 +63,7 @@ gc::managed_ptr string::init(vm::machine& vm)
     value::get<value::string>(self) = to_string(value::get<value::symbol>(arg));
   else
      value::get<value::string>(self) = pretty_print(arg, vm);
+  static_cast<value::string*>(self.get())->hash = 0;
   return self;
 }
 
@@ -101,14 +114,14 @@ gc::managed_ptr string::greater_equals(gc::managed_ptr self, gc::managed_ptr arg
 gc::managed_ptr string::add(gc::managed_ptr self, gc::managed_ptr arg)
 {
   if (arg.tag() == tag::string) {
-    const auto str = value::get<value::string>(arg);
-    return gc::alloc<value::string>( value::get<value::string>(self) + str );
+    const auto& str = *static_cast<value::string*>(arg.get());
+    if (value::size_of(str) < min_rope_length)
+      return concatenate(self, value::get<value::string>(arg));
+    return gc::alloc<value::string>( self, arg, std::string{} );
   }
 
-  if (arg.tag() == tag::character) {
-    const auto chr = value::get<value::character>(arg);
-    return gc::alloc<value::string>( value::get<value::string>(self) + chr );
-  }
+  if (arg.tag() == tag::character)
+    return concatenate(self, {value::get<value::character>(arg)});
 
   return throw_exception(type::type_error,
                          message::add_type_error(type::string, type::string));
@@ -121,8 +134,11 @@ gc::managed_ptr string::times(gc::managed_ptr self, gc::managed_ptr arg)
                            "Strings can only be multiplied by Integers");
 
   const auto& val = value::get<value::string>(self);
+  const auto count = value::get<value::integer>(arg);
   std::string new_str{};
-  for (auto i = value::get<value::integer>(arg); i--;)
+  if (count > 0)
+    new_str.reserve(val.size() * static_cast<size_t>(count));
+  for (auto i = count; i-- > 0;)
     new_str += val;
   return gc::alloc<value::string>( new_str );
 }
@@ -250,7 +266,7 @@ gc::managed_ptr string::replace(vm::machine& vm)
   if (vm.top().tag() != tag::regex)
     return throw_exception(type::type_error,
                            "Strings can only be replaced by Regexes");
-  const auto& re = value::get<value::regex>(vm.top()).val;
+  const auto& re = value::get<value::regex>(vm.top()).val->get();
 
   vm.self();
   const auto& str = value::get<value::string>(vm.top());
@@ -38,7 +38,8 @@ gc::managed_ptr custom_type::new_obj(vm::machine& vm)
                            message::nonconstructible(ctor_type));
   obj.get()->type = self;
   vm.push(obj);
-  vm.opt_tmpm({"init"});
+  static vm::method_cache init_cache;
+  vm.opt_tmpm({"init"}, init_cache);
   vm.call(init_argc);
   vm.run_cur_scope();
 
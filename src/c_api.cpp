@@ -323,7 +323,7 @@ vv_object_t vv_add_method(vv_object_t type,
   };
 
   const auto fn = gc::alloc<value::builtin_function>( cpp_func, argc );
-  value::get<value::type>(cast_from(type)).methods[{name}] = fn;
+  set_method(cast_from(type), {name}, fn);
   return cast_to(fn);
 }
 
@@ -338,7 +338,7 @@ vv_object_t vv_add_monop(vv_object_t type,
   };
 
   const auto fn = gc::alloc<value::opt_monop>( cpp_func );
-  value::get<value::type>(cast_from(type)).methods[{name}] = fn;
+  set_method(cast_from(type), {name}, fn);
   return cast_to(fn);
 }
 
@@ -353,7 +353,7 @@ vv_object_t vv_add_binop(vv_object_t type,
   };
 
   const auto fn = gc::alloc<value::opt_binop>( cpp_func );
-  value::get<value::type>(cast_from(type)).methods[{name}] = fn;
+  set_method(cast_from(type), {name}, fn);
   return cast_to(fn);
 }
 
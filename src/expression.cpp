@@ -1,11 +1,10 @@
 #include "expression.h"
 
-#include "opt.h"
 #include "vm/instruction.h"
 
-std::vector<vv::vm::command> vv::ast::expression::code() const
+vv::vm::bytecode vv::ast::expression::code() const
 {
-  auto vec = generate();
-  optimize(vec);
-  return vec;
+  return generate();
 }
+
+void vv::ast::expression::resolve(resolver&) const { }
@@ -3,26 +3,30 @@
 
 #include "symbol.h"
 
-#include <vector>
-
 namespace vv {
 
 namespace vm {
 
-struct command;
+class bytecode;
 
 }
 
 namespace ast {
 
+class resolver;
+
 // Base class for all AST nodes.
 class expression {
 public:
   // Code generator (internal; should be made protected); override to implement
   // AST class.
-  virtual std::vector<vm::command> generate() const = 0;
-  // Returns finalized VM code for this AST subtree.
-  std::vector<vm::command> code() const;
+  virtual vm::bytecode generate() const = 0;
+  // Resolves variables in this subtree (see resolver.h); override for any AST
+  // class with subexpressions, or that declares or accesses variables.
+  virtual void resolve(resolver& res) const;
+  // Returns VM code for this AST subtree. It's left unoptimized, since it'll
+  // be optimized along with the rest of the unit it's part of (see opt.h).
+  vm::bytecode code() const;
   virtual ~expression() { }
 };
 
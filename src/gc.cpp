@@ -2,6 +2,7 @@
 
 #include "gc/alloc.h"
 #include "gc/block_list.h"
+#include "gc/marker.h"
 #include "gc/object_list.h"
 
 #include "builtins.h"
@@ -19,6 +20,7 @@
 #include "value/type.h"
 #include "vm/call_frame.h"
 
+#include <chrono>
 #include <iostream>
 
 using namespace vv;
@@ -43,43 +45,214 @@ std::vector<dynamic_library> g_libs;
 // them separate.
 vm::machine* g_vm;
 
-// List of allocated basic_objects.
+// List of allocated basic_objects that have survived at least one collection.
 gc::object_list g_allocated;
 
+// Objects allocated since the last collection (the nursery). Objects are never
+// moved, since native code holds managed_ptrs directly, so promoting a survivor
+// just means moving it to g_allocated and leaving it marked; minor collections
+// then treat every marked object as live without tracing it.
+gc::object_list g_nursery;
+// Bytes allocated since the last collection.
+size_t g_nursery_bytes{};
+// Nursery size that triggers a minor collection.
+const size_t nursery_limit = 256 * 1024;
+
+// Objects allocated while no VM is running (i.e. the builtins, during startup).
+// Nothing's guaranteed to refer to these, so they're never freed, and are
+// always treated as roots.
+gc::object_list g_permanent;
+
+// Old objects that might refer to objects in the nursery (see write_barrier).
+std::vector<gc::managed_ptr> g_remembered;
+
+// Major collections only mark; dead objects in g_allocated are swept
+// afterwards, a little at a time, so that the pause doesn't grow with the size
+// of the heap. Everything in g_allocated before g_sweep_pos has been swept.
+bool g_sweeping{false};
+size_t g_sweep_pos{};
+// Objects freed by the current major collection so far.
+size_t g_swept{};
+// Objects swept at a time, either per allocation (in incremental mode) or until
+// there's room for an allocation.
+const size_t sweep_increment = 64;
+
+gc::sweep_mode g_sweep_mode{gc::sweep_mode::lazy};
+
+gc::collection_stats g_stats{};
+
 }
 
 namespace {
 
-// Performs actual marking and sweeping, along with expanding available memory
-// if we've genuinely run out.
-void mark_sweep()
+void trace(gc::managed_ptr obj);
+
+// Objects that have been marked, but not yet traced.
+internal::marker g_marker{trace};
+// Threads used to trace the heap during full collections.
+unsigned g_mark_threads{1};
+
+void free_object(gc::managed_ptr obj)
 {
-  const auto old_sz = g_allocated.size();
+  internal::g_blocks.reclaim(obj, size_for(obj.tag()));
+  clear_members(obj);
+  destroy(obj);
+}
 
+void mark_roots()
+{
   g_vm->mark();
   symbol::mark();
+  for (auto i : g_permanent)
+    mark(i);
+}
+
+void forget_remembered()
+{
+  for (auto i : g_remembered)
+    internal::g_blocks.forget(i);
+  g_remembered.clear();
+}
+
+// Frees every unmarked object in the nursery, and promotes the rest, returning
+// the number of objects freed.
+size_t sweep_nursery()
+{
+  size_t freed{};
+  for (auto i : g_nursery) {
+    if (internal::g_blocks.is_marked(i)) {
+      g_allocated.push_back(i);
+    }
+    else {
+      free_object(i);
+      ++freed;
+    }
+  }
+  g_nursery.clear();
+  g_nursery_bytes = 0;
+  return freed;
+}
+
+// Sweeps up to count objects in g_allocated. Objects are removed by swapping
+// them with the last one, so that anything promoted in the meantime (which is
+// appended, and marked) is simply swept along with everything else.
+void sweep_some(size_t count)
+{
+  for (; count-- && g_sweep_pos != g_allocated.size();) {
+    const auto obj = g_allocated[g_sweep_pos];
+    if (internal::g_blocks.is_marked(obj)) {
+      ++g_sweep_pos;
+    }
+    else {
+      free_object(obj);
+      ++g_swept;
+      g_allocated[g_sweep_pos] = g_allocated.back();
+      g_allocated.pop_back();
+    }
+  }
+
+  if (g_sweep_pos == g_allocated.size()) {
+    g_sweeping = false;
+    // Expand memory if less than half was reclaimed (to avoid cases if, e.g.,
+    // 50000 objects are marked and only 4 are swept, over and over again every
+    // 4 allocations).
+    if (g_swept < g_allocated.size())
+      internal::g_blocks.expand();
+  }
+}
+
+void finish_sweep()
+{
+  while (g_sweeping)
+    sweep_some(g_allocated.size());
+}
+
+// Sweeps until an object of the given size can be allocated, or there's
+// nothing left to sweep.
+gc::managed_ptr sweep_until_allocated(size_t sz)
+{
+  auto ptr = internal::g_blocks.allocate(sz);
+  while (!ptr && g_sweeping) {
+    sweep_some(sweep_increment);
+    ptr = internal::g_blocks.allocate(sz);
+  }
+  return ptr;
+}
+
+// Marks and sweeps only the nursery. Everything still marked from previous
+// collections is old, and treated as live; the only old objects traced are
+// those in the remembered set.
+void minor_collect()
+{
+  ++g_stats.minor;
+  mark_roots();
+  for (auto i : g_remembered)
+    trace(i);
+  g_marker.drain(1);
+  forget_remembered();
+  sweep_nursery();
+}
+
+// Marks the entire heap, and sweeps the nursery; the rest is swept lazily (see
+// sweep_some), expanding available memory afterwards if we've genuinely run
+// out.
+void major_collect()
+{
+  ++g_stats.major;
+  finish_sweep();
 
-  const auto last = remove_if(std::begin(g_allocated), std::end(g_allocated),
-                              [](auto i)
-  {
-    if (internal::g_blocks.is_marked(i))
-      return false;
-    internal::g_blocks.reclaim(i, size_for(i.tag()));
-    clear_members(i);
-    destroy(i);
-    return true;
-  });
-
-  g_allocated.erase(last, std::end(g_allocated));
   internal::g_blocks.unmark_all();
+  forget_remembered();
+  mark_roots();
+  g_marker.drain(g_mark_threads);
+
+  g_sweeping = true;
+  g_sweep_pos = 0;
+  g_swept = sweep_nursery();
+  sweep_some(0);
+}
 
-  // Expand memory if less than half was reclaimed (to avoid cases if, e.g.,
-  // 50000 objects are marked and only 4 are swept, over and over again every
-  // 4 allocations).
-  if (old_sz - g_allocated.size() < g_allocated.size())
+// Finds space for an object when there's no free space left, by (in order of
+// preference) sweeping, collecting the nursery, collecting everything, and
+// expanding the heap.
+gc::managed_ptr allocate_slow(size_t sz)
+{
+  auto ptr = sweep_until_allocated(sz);
+  if (!ptr && g_nursery.size()) {
+    minor_collect();
+    ptr = internal::g_blocks.allocate(sz);
+  }
+  if (!ptr) {
+    major_collect();
+    ptr = sweep_until_allocated(sz);
+  }
+  // Free memory is segregated by size, so even a collection that reclaimed
+  // plenty might not have freed anything of this size
+  if (!ptr) {
     internal::g_blocks.expand();
+    ptr = internal::g_blocks.allocate(sz);
+  }
+  return ptr;
 }
 
+// Records how long the garbage collector paused the program for, from
+// construction until destruction.
+class pause_timer {
+public:
+  pause_timer() : m_start{std::chrono::steady_clock::now()} { }
+
+  ~pause_timer()
+  {
+    const auto pause = std::chrono::steady_clock::now() - m_start;
+    g_stats.total_pause += pause;
+    g_stats.max_pause = std::max<std::chrono::nanoseconds>(g_stats.max_pause,
+                                                           pause);
+  }
+
+private:
+  std::chrono::steady_clock::time_point m_start;
+};
+
 }
 
 // }}}
@@ -87,14 +260,37 @@ void mark_sweep()
 
 gc::managed_ptr gc::internal::get_next_empty(const tag type, const size_t sz)
 {
+  // No roots to collect from until there's a VM running, so anything allocated
+  // before then (e.g. during startup) is permanent
+  if (!g_vm) {
+    auto ptr = g_blocks.allocate(sz);
+    if (!ptr) {
+      g_blocks.expand();
+      ptr = g_blocks.allocate(sz);
+    }
+    ptr.m_tag = type;
+    g_permanent.push_back(ptr);
+    return ptr;
+  }
+
+  const auto incremental = g_sweeping && g_sweep_mode == sweep_mode::incremental;
+  if (incremental || g_nursery_bytes >= nursery_limit) {
+    pause_timer pause;
+    if (incremental)
+      sweep_some(sweep_increment);
+    if (g_nursery_bytes >= nursery_limit)
+      minor_collect();
+  }
+
   auto ptr = g_blocks.allocate(sz);
   if (!ptr) {
-    mark_sweep();
-    ptr = g_blocks.allocate(sz);
+    pause_timer pause;
+    ptr = allocate_slow(sz);
   }
 
   ptr.m_tag = type;
-  g_allocated.push_back(ptr);
+  g_nursery.push_back(ptr);
+  g_nursery_bytes += sz;
   return ptr;
 }
 
@@ -103,11 +299,47 @@ void gc::set_running_vm(vm::machine& vm)
   g_vm = &vm;
 }
 
+void gc::stop_running_vm(vm::machine& vm)
+{
+  if (g_vm == &vm)
+    g_vm = nullptr;
+}
+
 vm::machine& gc::get_running_vm()
 {
   return *g_vm;
 }
 
+void gc::write_barrier(managed_ptr container)
+{
+  if (!container || container.is_immediate())
+    return;
+  // Objects in the nursery will be traced anyways
+  if (internal::g_blocks.is_marked(container) && internal::g_blocks.remember(container))
+    g_remembered.push_back(container);
+}
+
+void gc::collect()
+{
+  pause_timer pause;
+  major_collect();
+}
+
+void gc::set_mark_threads(unsigned threads)
+{
+  g_mark_threads = std::max(threads, 1u);
+}
+
+void gc::set_sweep_mode(sweep_mode mode)
+{
+  g_sweep_mode = mode;
+}
+
+const gc::collection_stats& gc::stats()
+{
+  return g_stats;
+}
+
 dynamic_library& gc::load_dynamic_library(const std::string& filename)
 {
   g_libs.emplace_back(filename);
@@ -130,6 +362,14 @@ void mark_dictionary(gc::managed_ptr dictionary)
   }
 }
 
+void mark_string(gc::managed_ptr string)
+{
+  // Not through value::get, which would flatten it
+  const auto& str = static_cast<value::string&>(*string.get());
+  mark(str.left);
+  mark(str.right);
+}
+
 void mark_method(gc::managed_ptr method)
 {
   mark(value::get<value::method>(method).function);
@@ -159,6 +399,8 @@ void mark_environment(gc::managed_ptr env)
 {
   mark(value::get<vm::environment>(env).enclosing);
   mark(value::get<vm::environment>(env).self);
+  for (auto i : value::get<vm::environment>(env).slots)
+    mark(i);
   for (auto i : value::get<vm::environment>(env).members)
     gc::mark(i.second);
 }
@@ -167,23 +409,25 @@ void mark_environment(gc::managed_ptr env)
 
 void gc::mark(managed_ptr obj)
 {
-  using namespace value;
-
   if (!obj)
     return;
 
-  if (obj.tag() == tag::boolean || obj.tag() == tag::character ||
-      obj.tag() == tag::integer || obj.tag() == tag::nil) {
+  if (obj.is_immediate()) {
     mark(obj.type());
     mark_members(obj);
     return;
   }
 
-  // Either already marked or stack-allocated
-  if (internal::g_blocks.is_marked(obj))
-    return;
+  if (internal::g_blocks.mark(obj))
+    g_marker.push(obj);
+}
+
+namespace {
 
-  internal::g_blocks.mark(obj);
+// Marks everything obj refers to.
+void trace(managed_ptr obj)
+{
+  using namespace value;
 
   mark(obj.type());
   mark_members(obj);
@@ -197,6 +441,7 @@ void gc::mark(managed_ptr obj)
   case tag::partial_function: return mark_partial_function(obj);
   case tag::range:            return mark_range(obj);
   case tag::regex_result:     return mark(get<regex_result>(obj).owning_str);
+  case tag::string:           return mark_string(obj);
   case tag::string_iterator:  return mark(get<string_iterator>(obj).str);
   case tag::type:             return mark_type(obj);
   case tag::environment:      return mark_environment(obj);
@@ -204,5 +449,7 @@ void gc::mark(managed_ptr obj)
   }
 }
 
+}
+
 // }}}
 
@@ -6,18 +6,61 @@
 #include "vm.h"
 
 #include <array>
+#include <chrono>
 
 namespace vv {
 
 namespace gc {
 
 void set_running_vm(vm::machine& vm);
+// Called when vm is destroyed; until another VM starts running, everything
+// allocated is treated as permanent.
+void stop_running_vm(vm::machine& vm);
 vm::machine& get_running_vm();
 
 dynamic_library& load_dynamic_library(const std::string& filename);
 
+// Marks basic_object as reachable; anything it refers to will be traced before
+// the current collection finishes.
 void mark(gc::managed_ptr basic_object);
 
+// Performs a full collection immediately.
+void collect();
+
+// Sets the number of threads used to trace the heap during full collections
+// (by default, just the one running the VM).
+void set_mark_threads(unsigned threads);
+
+// Must be called whenever a reference is stored in an existing object (as
+// opposed to one that's being constructed), e.g. by assigning to an array
+// element or a variable in a heap-allocated environment. Objects surviving a
+// minor collection aren't traced again until the next full collection, so
+// this is how minor collections find references from them to newer objects.
+void write_barrier(gc::managed_ptr container);
+
+// How the objects left dead by a full collection are freed. In either mode,
+// they're swept a little at a time whenever an allocation can't otherwise find
+// space; in incremental mode, a bounded amount is also swept on every
+// allocation, so that memory's freed sooner at a small constant cost.
+enum class sweep_mode {
+  lazy,
+  incremental
+};
+void set_sweep_mode(sweep_mode mode);
+
+// Collection counts and pause times, for profiling.
+struct collection_stats {
+  // Collections that only scanned objects allocated since the last collection.
+  size_t minor;
+  // Collections that scanned the entire heap.
+  size_t major;
+  // Time spent in the garbage collector (collecting or sweeping), in total and
+  // for the single longest interruption.
+  std::chrono::nanoseconds total_pause;
+  std::chrono::nanoseconds max_pause;
+};
+const collection_stats& stats();
+
 }
 
 }
@@ -4,6 +4,9 @@
 #include "symbol.h"
 #include "value.h"
 #include "gc/managed_ptr.h"
+#include "value/floating_point.h"
+
+#include <cstring>
 
 namespace vv {
 
@@ -105,6 +108,46 @@ inline gc::managed_ptr alloc<value::integer>()
   return alloc<value::integer, value::integer>(0);
 }
 
+// Floats are stored in the pointer itself whenever they fit, and on the heap
+// otherwise (see managed_ptr::unboxed_float).
+inline gc::managed_ptr internal::alloc_float(const double val)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &val, sizeof(bits));
+  if (bits & 0xffff) {
+    auto slot = get_next_empty(tag::floating_point, sizeof(value::floating_point));
+    new (slot.get()) value::floating_point{val};
+    return slot;
+  }
+  return {static_cast<uint32_t>(bits >> 32),
+          static_cast<uint16_t>((bits >> 16) & 0xffff),
+          tag::floating_point, managed_ptr::unboxed_float};
+}
+
+template <>
+inline gc::managed_ptr alloc<value::floating_point, double>(double&& val)
+{
+  return internal::alloc_float(val);
+}
+
+template <>
+inline gc::managed_ptr alloc<value::floating_point, double&>(double& val)
+{
+  return internal::alloc_float(val);
+}
+
+template <>
+inline gc::managed_ptr alloc<value::floating_point, const double&>(const double& val)
+{
+  return internal::alloc_float(val);
+}
+
+template <>
+inline gc::managed_ptr alloc<value::floating_point, float>(float&& val)
+{
+  return internal::alloc_float(static_cast<double>(val));
+}
+
 template <>
 inline gc::managed_ptr alloc<value::symbol, std::string_view>(std::string_view&& val)
 {
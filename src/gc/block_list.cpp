@@ -8,98 +8,106 @@ using namespace gc;
 // Marking functions {{{
 
 block_list::block_list()
+  : m_list       {},
+    m_cur_block  {0},
+    m_free_lists {}
 {
   for (auto i = 16; i--;)
     add_new_block();
-  m_cur_pos = begin(m_list);
 }
 
 bool block_list::is_marked(gc::managed_ptr ptr) const
 {
-  const auto& blk = m_list[ptr.m_block];
-  return blk->markings[ptr.m_offset / 8];
+  const auto idx = ptr.m_offset / granule;
+  const auto& word = m_list[ptr.m_block]->markings[idx / 64];
+  return word.load(std::memory_order_relaxed) & (uint64_t{1} << (idx % 64));
 }
 
-void block_list::mark(gc::managed_ptr ptr)
+bool block_list::mark(gc::managed_ptr ptr)
 {
-  const auto& blk = m_list[ptr.m_block];
-  blk->markings.set(ptr.m_offset / 8);
+  const auto idx = ptr.m_offset / granule;
+  auto& word = m_list[ptr.m_block]->markings[idx / 64];
+  const auto bit = uint64_t{1} << (idx % 64);
+  // Only bother with an atomic read-modify-write if it isn't already marked
+  if (word.load(std::memory_order_relaxed) & bit)
+    return false;
+  return !(word.fetch_or(bit, std::memory_order_relaxed) & bit);
 }
 
 void block_list::unmark_all()
 {
-  for (auto& i : m_list)
-    i->markings.reset();
+  for (auto& i : m_list) {
+    for (auto& word : i->markings)
+      word.store(0, std::memory_order_relaxed);
+  }
 }
 
-// }}}
-// Allocation functions {{{
+bool block_list::remember(gc::managed_ptr ptr)
+{
+  auto&& bit = m_list[ptr.m_block]->remembered[ptr.m_offset / 8];
+  if (bit)
+    return false;
+  bit = true;
+  return true;
+}
 
-namespace {
+void block_list::forget(gc::managed_ptr ptr)
+{
+  m_list[ptr.m_block]->remembered.reset(ptr.m_offset / 8);
+}
 
-template <typename I, typename P>
-I circular_find(const I& begin, const I& start, const I& end, const P& pred)
+bool block_list::has_members(gc::managed_ptr ptr) const
 {
-  auto i = find_if(start, end, pred);
-  if (i == end) {
-    i = find_if(begin, start, pred);
-    if (i == start)
-      return end;
-  }
-  return i;
+  return m_list[ptr.m_block]->has_members[ptr.m_offset / 8];
 }
 
-template <typename V>
-char* get_allocated_space(V& blk,
-                         typename V::iterator& cur_pos,
-                         const size_t sz)
+void block_list::set_has_members(gc::managed_ptr ptr, const bool flag)
 {
-  auto it = circular_find(begin(blk), cur_pos, end(blk),
-                          [sz](auto blk) { return blk.size >= sz; });
+  m_list[ptr.m_block]->has_members[ptr.m_offset / 8] = flag;
+}
 
-  if (it != end(blk)) {
-    const auto ptr = it->data;
+// }}}
+// Allocation functions {{{
 
-    if (it->size > sz) {
-      it->data += sz;
-      it->size -= sz;
-    }
-    else {
-      // whoops
-      it = blk.erase(it);
-    }
+namespace {
 
-    cur_pos = it;
-    return ptr;
-  }
-  return nullptr;
+// Size in granules of an object of the given size in bytes.
+size_t size_class_for(const size_t size, const size_t granule)
+{
+  return std::max<size_t>((size + granule - 1) / granule, 1);
 }
 
 }
 
 gc::managed_ptr block_list::allocate(const size_t size)
 {
-  for (auto i = m_cur_pos; i != end(m_list); ++i) {
-    const auto ptr = get_allocated_space((*i)->free_list, (*i)->free_pos, size);
-    if (ptr) {
-      m_cur_pos = i;
-      const auto block_idx = i - begin(m_list);
-      const auto block_os = ptr - (*i)->block.data();
-      return { static_cast<uint32_t>(block_idx),
-               static_cast<uint16_t>(block_os),
-               tag::nil, 1 };
+  const auto size_class = size_class_for(size, granule);
+
+  if (size_class < m_free_lists.size()) {
+    auto& head = m_free_lists[size_class];
+    if (head.block != no_block) {
+      const auto chunk = head;
+      head = *reinterpret_cast<free_chunk*>(data_for(chunk));
+      return { chunk.block, chunk.offset, tag::nil, 1 };
     }
   }
-  for (auto i = begin(m_list); i != m_cur_pos; ++i) {
-    const auto ptr = get_allocated_space((*i)->free_list, (*i)->free_pos, size);
-    if (ptr) {
-      m_cur_pos = i;
-      const auto block_idx = i - begin(m_list);
-      const auto block_os = ptr - (*i)->block.data();
-      return { static_cast<uint32_t>(block_idx),
-               static_cast<uint16_t>(block_os),
+
+  for (; m_cur_block != m_list.size(); ++m_cur_block) {
+    auto& blk = *m_list[m_cur_block];
+    if (blk.top + size_class * granule <= blk.block.size()) {
+      const auto offset = blk.top;
+      blk.top += size_class * granule;
+      return { static_cast<uint32_t>(m_cur_block),
+               static_cast<uint16_t>(offset),
                tag::nil, 1 };
     }
+    // Save whatever's left over for some smaller object
+    if (blk.top != blk.block.size()) {
+      push_free({ static_cast<uint32_t>(m_cur_block),
+                  static_cast<uint16_t>(blk.top) },
+                (blk.block.size() - blk.top) / granule);
+      blk.top = blk.block.size();
+    }
   }
 
   return {};
@@ -107,61 +115,35 @@ gc::managed_ptr block_list::allocate(const size_t size)
 
 void block_list::reclaim(gc::managed_ptr ptr, const size_t size)
 {
-  const auto it = begin(m_list) + ptr.m_block;
-  auto& list = (*it)->free_list;
-
-  const auto ch_ptr = ptr.m_offset + (*it)->block.data();
-
-  const auto pos = upper_bound(begin(list), end(list), ch_ptr,
-                               [](auto* ch_ptr, auto blk) { return ch_ptr < blk.data; });
-
-  if (pos != begin(list)) {
-    const auto prev = pos - 1;
-    if (prev->data + prev->size == ch_ptr) {
-      prev->size += size;
-      if (pos != end(list) && pos->data == prev->data + prev->size) {
-        prev->size += pos->size;
-        (*it)->free_pos = list.erase(pos);
-      }
-      return;
-    }
-  }
-
-  if (pos != end(list) && pos->data == ch_ptr + size) {
-    pos->size += size;
-    pos->data = ch_ptr;
-  }
-  else {
-    (*it)->free_pos = list.insert(pos, {size, ch_ptr});
-  }
+  push_free({ ptr.m_block, ptr.m_offset }, size_class_for(size, granule));
 }
 
 void block_list::expand()
 {
-  const auto size = m_list.size();
-  for (auto i = size / 2; i--;)
+  for (auto i = m_list.size() / 2; i--;)
     add_new_block();
-  m_cur_pos = begin(m_list) + size;
 }
 
-void block_list::shrink_to_fit()
+void block_list::add_new_block()
 {
-  // Can't defragment without invalidating pointers, unfortunately, so for now
-  // just remove unused blocks.
-  const auto valid_end = remove_if(begin(m_list), end(m_list), [](auto&& i)
-  {
-    return i->free_list.size() == 1 && i->free_list.front().size == i->block.size();
-  });
-  m_list.erase(valid_end, end(m_list));
+  auto block = std::make_unique<block_list::block>( );
+  block->top = 0;
+  m_list.emplace_back(move(block));
 }
 
-void block_list::add_new_block()
+char* block_list::data_for(const free_chunk chunk) const
 {
-  auto block = std::make_unique<block_list::block>( );
-  block->free_list.push_back({block->block.size(), block->block.data()});
-  block->free_pos = begin(block->free_list);
+  return m_list[chunk.block]->block.data() + chunk.offset;
+}
 
-  m_list.emplace_back(move(block));
+void block_list::push_free(const free_chunk chunk, const size_t size_class)
+{
+  if (size_class >= m_free_lists.size())
+    m_free_lists.resize(size_class + 1, { no_block, 0 });
+
+  auto& head = m_free_lists[size_class];
+  *reinterpret_cast<free_chunk*>(data_for(chunk)) = head;
+  head = chunk;
 }
 
 // }}}
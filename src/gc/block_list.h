@@ -2,7 +2,9 @@
 #define VV_GC_BLOCK_LIST
 
 #include <array>
+#include <atomic>
 #include <bitset>
+#include <cstdint>
 #include <vector>
 
 namespace vv {
@@ -19,6 +21,11 @@ class managed_ptr;
 // that the various functions this class handles are really interconnected, so
 // it's more convenient to glom them together). TODO: Move more GC functionality
 // to this class, so we can get rid of some of the remaining GC-related globals.
+//
+// Since objects only come in a handful of sizes (see vv::size_for), free space
+// is segregated by size: reclaimed memory goes on a free list for its size,
+// and is only reused by objects of that exact size. Everything else is
+// bump-allocated from the unused end of the current block.
 class block_list {
 public:
   block_list();
@@ -29,44 +36,73 @@ public:
 
   // After calling this function, is_marked(ptr) will return true. As above, ptr
   // *must* be allocated by this class (i.e. contains(ptr) must return true).
-  void mark(gc::managed_ptr ptr);
+  // Returns false if ptr was already marked. Safe to call from several threads
+  // at once (see gc::internal::marker).
+  bool mark(gc::managed_ptr ptr);
   // Unmarks all allocated objects.
   void unmark_all();
 
+  // Adds ptr to the remembered set, returning false if it was already in it.
+  // ptr must be allocated by this class.
+  bool remember(gc::managed_ptr ptr);
+  // Removes ptr from the remembered set.
+  void forget(gc::managed_ptr ptr);
+
+  // Returns true if ptr has been flagged as having members stored outside of
+  // it (see vv::set_member). ptr must be allocated by this class.
+  bool has_members(gc::managed_ptr ptr) const;
+  // Sets or clears the flag checked by has_members.
+  void set_has_members(gc::managed_ptr ptr, bool flag);
+
   // Provides a pointer to a block of memory of the given size, or nullptr if
   // none can be found (in that case, destruct and call reclaim on unused
   // objects, or expand).
   gc::managed_ptr allocate(size_t size);
-  // Re-adds the given block of memory to the free list. The provided memory
-  // *must* have originallly been obtained via allocate.
+  // Re-adds the given block of memory to the free list for its size. The
+  // provided memory *must* have originallly been obtained via allocate, with
+  // the same size.
   void reclaim(gc::managed_ptr ptr, size_t size);
 
   // Expands available memory by ~50% (including currently allocated memory),
   // providing free space if none exists.
   void expand();
 
-  // Tries to release unused memory.
-  void shrink_to_fit();
-
 private:
+  // Every object is allocated in a multiple of this size (which is also the
+  // granularity of the mark bits).
+  static const size_t granule = 8;
+
+  // Location of a free chunk of memory. Free chunks of the same size class are
+  // kept in a singly linked list, with each chunk storing the location of the
+  // next one.
+  struct free_chunk {
+    uint32_t block;
+    uint16_t offset;
+  };
+  static const uint32_t no_block = UINT32_MAX;
 
   void add_new_block();
-
-  struct free_block {
-    size_t size;
-    char* data;
-  };
+  char* data_for(free_chunk chunk) const;
+  void push_free(free_chunk chunk, size_t size_class);
 
   struct block {
     std::array<char, 65'536> block;
-    std::bitset<8'192> markings;
+    // One bit per granule; atomic, so that marking can be done in parallel.
+    std::array<std::atomic<uint64_t>, 128> markings;
+    std::bitset<8'192> remembered;
+    std::bitset<8'192> has_members;
 
-    std::vector<free_block> free_list;
-    std::vector<free_block>::iterator free_pos;
+    // Everything from this offset on has never been allocated.
+    size_t top;
   };
 
   std::vector<std::unique_ptr<block>> m_list;
-  std::vector<std::unique_ptr<block>>::iterator m_cur_pos;
+  // Block currently being bump-allocated from; every block before it has been
+  // used up.
+  size_t m_cur_block;
+
+  // Head of the free list for each size class (size in granules).
+  std::vector<free_chunk> m_free_lists;
 
   friend class gc::managed_ptr;
 };
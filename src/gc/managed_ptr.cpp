@@ -10,12 +10,15 @@ using namespace gc;
 managed_ptr managed_ptr::type() const
 {
   switch (m_tag) {
-  case tag::nil:       return builtin::type::nil;
-  case tag::boolean:   return builtin::type::boolean;
-  case tag::character: return builtin::type::character;
-  case tag::integer:   return builtin::type::integer;
-  case tag::symbol:    return builtin::type::symbol;
-  default:             return get()->type;
+  case tag::nil:            return builtin::type::nil;
+  case tag::boolean:        return builtin::type::boolean;
+  case tag::character:      return builtin::type::character;
+  case tag::integer:        return builtin::type::integer;
+  case tag::symbol:         return builtin::type::symbol;
+  // Floats aren't constructible, so they're never anything but Floats (and
+  // unboxed ones don't have anywhere to store a type anyways)
+  case tag::floating_point: return builtin::type::floating_point;
+  default:                  return get()->type;
   }
 }
 
@@ -67,6 +67,7 @@ namespace internal {
 
 extern block_list g_blocks;
 gc::managed_ptr get_next_empty(tag type, size_t sz);
+inline gc::managed_ptr alloc_float(double val);
 
 }
 
@@ -88,6 +89,15 @@ public:
   vv::tag tag() const { return m_tag; }
   gc::managed_ptr type() const;
 
+  // Returns true if the value is stored in the pointer itself, rather than on
+  // the heap (booleans, characters, integers, nil, and most Floats).
+  bool is_immediate() const
+  {
+    return m_tag == vv::tag::boolean || m_tag == vv::tag::character ||
+           m_tag == vv::tag::integer || m_tag == vv::tag::nil ||
+           m_flags == unboxed_float;
+  }
+
   operator bool() const { return m_flags; }
   operator size_t() const = delete;
 
@@ -99,6 +109,11 @@ private:
       m_flags  {flags}
   { }
 
+  // Floats whose bottom 16 bits are all zero (which includes every integer up
+  // to 2^37, and most fractions with small denominators) are stored directly
+  // in m_block and m_offset, marked by this value of m_flags.
+  static const int unboxed_float = 3;
+
   uint32_t m_block  : 32;
   uint16_t m_offset : 16;
   vv::tag  m_tag    : 8;
@@ -109,6 +124,7 @@ private:
   template <typename T, typename... Args>
   friend managed_ptr gc::alloc(Args&&... args);
   friend managed_ptr internal::get_next_empty(vv::tag, size_t);
+  friend managed_ptr internal::alloc_float(double);
   friend class gc::block_list;
 
   friend bool operator==(managed_ptr, managed_ptr) noexcept;
@@ -0,0 +1,133 @@
+#include "marker.h"
+
+#include <thread>
+
+using namespace vv;
+using namespace gc;
+
+namespace {
+
+// Stack that objects marked by the current thread are pushed onto.
+thread_local std::vector<gc::managed_ptr>* t_stack;
+
+// Once a thread has more than this many objects waiting to be traced, it
+// starts sharing them with idle threads.
+const size_t share_threshold = 64;
+
+}
+
+internal::marker::marker(void (*trace)(gc::managed_ptr))
+  : m_trace   {trace},
+    m_workers {},
+    m_active  {0}
+{
+  m_workers.push_back(std::make_unique<worker>( ));
+  t_stack = &m_workers.front()->local;
+}
+
+void internal::marker::push(gc::managed_ptr obj)
+{
+  t_stack->push_back(obj);
+}
+
+void internal::marker::drain(const unsigned threads)
+{
+  if (threads <= 1) {
+    auto& stack = m_workers.front()->local;
+    while (!stack.empty()) {
+      const auto obj = stack.back();
+      stack.pop_back();
+      m_trace(obj);
+    }
+    return;
+  }
+
+  while (m_workers.size() < threads)
+    m_workers.push_back(std::make_unique<worker>( ));
+  m_active = threads;
+
+  std::vector<std::thread> helpers;
+  for (size_t i = 1; i != threads; ++i)
+    helpers.emplace_back([this, i] { run(i); });
+  run(0);
+  for (auto& i : helpers)
+    i.join();
+}
+
+void internal::marker::run(const size_t idx)
+{
+  auto& self = *m_workers[idx];
+  t_stack = &self.local;
+
+  do {
+    while (!self.local.empty()) {
+      const auto obj = self.local.back();
+      self.local.pop_back();
+      m_trace(obj);
+
+      if (self.local.size() > share_threshold && !self.shared_size)
+        share(self);
+    }
+  } while (find_work(idx));
+}
+
+void internal::marker::share(worker& from)
+{
+  // Share the oldest half, which is likely to lead to the most work
+  const auto half = begin(from.local) + static_cast<ptrdiff_t>(from.local.size() / 2);
+
+  std::lock_guard<std::mutex> lock{from.lock};
+  from.shared.insert(end(from.shared), begin(from.local), half);
+  from.shared_size = from.shared.size();
+  from.local.erase(begin(from.local), half);
+}
+
+bool internal::marker::steal(worker& from, worker& to)
+{
+  std::lock_guard<std::mutex> lock{from.lock};
+  // Take everything back from ourselves, but only half from anyone else
+  const auto count = &from == &to ? from.shared.size()
+                                  : (from.shared.size() + 1) / 2;
+  const auto last = begin(from.shared) + static_cast<ptrdiff_t>(count);
+  to.local.insert(end(to.local), begin(from.shared), last);
+  from.shared.erase(begin(from.shared), last);
+  from.shared_size = from.shared.size();
+  return count != 0;
+}
+
+bool internal::marker::find_work(const size_t idx)
+{
+  auto& self = *m_workers[idx];
+
+  const auto try_steal = [&]
+  {
+    if (self.shared_size && steal(self, self))
+      return true;
+    for (size_t i = 0; i != m_workers.size(); ++i) {
+      if (i != idx && m_workers[i]->shared_size && steal(*m_workers[i], self))
+        return true;
+    }
+    return false;
+  };
+
+  if (try_steal())
+    return true;
+
+  // Only threads with work of their own ever share it, so once every thread's
+  // gone idle there's nothing left anywhere
+  --m_active;
+  for (;;) {
+    if (!m_active)
+      return false;
+
+    const auto has_work = any_of(begin(m_workers), end(m_workers),
+                                 [](const auto& i) { return i->shared_size != 0; });
+    if (has_work) {
+      ++m_active;
+      if (try_steal())
+        return true;
+      --m_active;
+    }
+    std::this_thread::yield();
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef VV_GC_MARKER_H
+#define VV_GC_MARKER_H
+
+#include "gc/managed_ptr.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vv {
+
+namespace gc {
+
+namespace internal {
+
+// Traces everything reachable from the objects marked during a collection.
+// Rather than recursing, marked objects are pushed onto an explicit stack, so
+// deeply nested structures can't overflow the native stack.
+//
+// Tracing can optionally be split across several threads. Each thread works
+// off its own private stack, and shares some of it (on a separate, locked
+// deque) whenever it has plenty of work and nothing's currently shared; threads
+// that run out of work steal half of someone else's shared work. Marking itself
+// has to be atomic (see block_list::mark), but otherwise tracing only reads the
+// heap, so nothing else needs to be synchronized.
+class marker {
+public:
+  // trace should call gc::mark on everything the provided object refers to.
+  marker(void (*trace)(gc::managed_ptr));
+
+  // Pushes a newly marked object, to be traced later by whichever thread
+  // marked it.
+  void push(gc::managed_ptr obj);
+
+  // Traces everything pushed so far, and everything reachable from it, using
+  // the given number of threads (including the calling one).
+  void drain(unsigned threads);
+
+private:
+  struct worker {
+    std::vector<gc::managed_ptr> local;
+
+    std::mutex lock;
+    std::deque<gc::managed_ptr> shared;
+    // Size of shared, so other threads can check for work without locking.
+    std::atomic<size_t> shared_size;
+  };
+
+  void run(size_t idx);
+  void share(worker& from);
+  bool steal(worker& from, worker& to);
+  // Tries to find more work for workers[idx], returning false once every thread
+  // has run out.
+  bool find_work(size_t idx);
+
+  void (*m_trace)(gc::managed_ptr);
+  std::vector<std::unique_ptr<worker>> m_workers;
+  // Number of threads that might still produce more work.
+  std::atomic<size_t> m_active;
+};
+
+}
+
+}
+
+}
+
+#endif
@@ -16,8 +16,13 @@ public:
   size_t size() const { return m_list.size(); }
 
   void push_back(gc::managed_ptr obj) { m_list.push_back(obj); }
+  void pop_back() { m_list.pop_back(); }
+
+  gc::managed_ptr& operator[](size_t idx) { return m_list[idx]; }
+  gc::managed_ptr& back() { return m_list.back(); }
 
   void erase(iterator first, iterator second) { m_list.erase(first, second); }
+  void clear() { m_list.clear(); }
 
   iterator begin() { return std::begin(m_list); }
   iterator end()   { return std::end(m_list); }
@@ -82,6 +82,21 @@ bool vv::is_c_exension(const std::string& filename)
   return ref.ends_with(".so") || ref.ends_with(".dylib");
 }
 
+std::string vv::canonical_filename(const std::string& filename,
+                                   const std::string& path)
+{
+  boost::system::error_code err;
+  const auto real = canonical(boost::filesystem::path{filename}, path, err);
+  return err ? "" : real.native();
+}
+
+std::time_t vv::modification_time(const std::string& filename)
+{
+  boost::system::error_code err;
+  const auto time = last_write_time(boost::filesystem::path{filename}, err);
+  return err ? -1 : time;
+}
+
 read_file_result vv::get_file_contents(const std::string& filename,
                                        const std::string& cur_path)
 {
@@ -100,16 +115,16 @@ read_file_result vv::get_file_contents(const std::string& filename,
     return { path.native(), message_for(tokens, filename, validator) };
 
   const auto exprs = parse(tokens);
-  std::vector<vm::command> body;
+  vm::bytecode body;
   // set working directory to path of file, so nested 'require's don't bork
   body.emplace_back(vm::instruction::chreqp, path.native());
   body.emplace_back(vm::instruction::pnil); // HACK--- for pops below
   for (const auto& i : exprs) {
     const auto code = i->code();
     body.emplace_back(vm::instruction::pop, 1);
-    copy(begin(code), end(code), back_inserter(body));
+    body.append(code);
   }
-  return { path.native(), move(body) };
+  return { path.native(), std::move(body) };
 }
 
 boost::optional<std::string> vv::read_c_lib(const std::string& filename)
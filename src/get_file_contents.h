@@ -4,6 +4,8 @@
 #include "vm/call_frame.h"
 
 #include <boost/optional.hpp>
+
+#include <ctime>
 #include <string>
 
 namespace vv {
@@ -16,7 +18,7 @@ public:
       m_dir {dir}
   { }
   read_file_result(const std::string& dir,
-                   std::vector<vm::command>&& instructions)
+                   vm::bytecode&& instructions)
     : m_successful {true},
       m_result     {instructions},
       m_dir        {dir}
@@ -26,15 +28,15 @@ public:
 
   const std::string& error() const { return m_err; }
 
-  std::vector<vm::command>& result() { return m_result; }
-  const std::vector<vm::command>& result() const { return m_result; }
+  vm::bytecode& result() { return m_result; }
+  const vm::bytecode& result() const { return m_result; }
 
   const std::string& file_directory() const { return m_dir; }
 
 private:
   bool m_successful;
   std::string m_err;
-  std::vector<vm::command> m_result;
+  vm::bytecode m_result;
   std::string m_dir;
 };
 
@@ -42,6 +44,15 @@ std::string get_real_filename(const std::string& filename,
                               const std::string& path = "");
 bool is_c_exension(const std::string& filename);
 
+// Returns the absolute name of filename, with any symbolic links resolved, or
+// an empty string if there's no such file.
+std::string canonical_filename(const std::string& filename,
+                               const std::string& path = "");
+// Returns when filename was last modified, or -1 if it couldn't be checked.
+std::time_t modification_time(const std::string& filename);
+
+// Reads, parses, and generates code for the file filename, which is left
+// unoptimized (see opt.h).
 read_file_result get_file_contents(const std::string& filename,
                                    const std::string& path = "");
 
@@ -3,6 +3,7 @@
 #include "get_file_contents.h"
 #include "messages.h"
 #include "opt.h"
+#include "output.h"
 #include "repl.h"
 #include "vm.h"
 #include "gc/alloc.h"
@@ -10,10 +11,36 @@
 #include "value/array.h"
 #include "value/string.h"
 
+#include <cstdlib>
 #include <iostream>
 
+namespace {
+
+void print_gc_stats()
+{
+  const auto& stats = vv::gc::stats();
+  const auto ms = [](auto time)
+  {
+    return std::chrono::duration<double, std::milli>(time).count();
+  };
+  std::cerr << "gc: " << stats.minor << " minor, " << stats.major
+            << " major collections; " << ms(stats.total_pause)
+            << " ms paused in total, " << ms(stats.max_pause)
+            << " ms at most\n";
+}
+
+}
+
 int main(int argc, char** argv)
 {
+  // Garbage collector options, for profiling latency-sensitive scripts
+  if (std::getenv("VV_GC_INCREMENTAL"))
+    vv::gc::set_sweep_mode(vv::gc::sweep_mode::incremental);
+  if (const auto threads = std::getenv("VV_GC_THREADS"))
+    vv::gc::set_mark_threads(static_cast<unsigned>(std::max(std::atoi(threads), 1)));
+  if (std::getenv("VV_GC_STATS"))
+    std::atexit(print_gc_stats);
+
   vv::builtin::init();
   // Run REPL if run with no arguments; otherwise, run Vivaldi file
   if (argc == 1) {
@@ -38,6 +65,9 @@ int main(int argc, char** argv)
 
     // Initiate VM
     vv::vm::machine vm{std::move(frame)};
+    // For long-running scripts that require files as they're being edited
+    if (std::getenv("VV_RELOAD_MODULES"))
+      vm.set_reload_modules(true);
 
     // Add argument 'argv' to the base environment. Done in this weird order for
     // GC reasons (not *really* necessary, since GC won't be triggered until 1Kb
@@ -58,6 +88,7 @@ int main(int argc, char** argv)
     try {
       vm.run();
     } catch (vv::vm_error& err) {
+      vv::output::flush();
       std::cerr << vv::message::caught_exception(err.error()) << '\n';
       return 65; // data err
     }
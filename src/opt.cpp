@@ -1,9 +1,15 @@
 #include "opt.h"
 
 #include "builtins.h"
+#include "utils/hash_map.h"
 #include "value.h"
 #include "vm/instruction.h"
 
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
 using namespace vv;
 
 namespace {
@@ -14,21 +20,28 @@ bool is_eblk(const vm::command& com);
 bool is_lblk(const vm::command& com);
 bool affects_env(const vm::command& com);
 bool uses_local_vars(const vm::command& com);
+bool is_local_access(const vm::command& com);
 bool captures_local_env(const vm::command& com);
-bool is_opt_fn(const vm::command& com);
-bool is_opt_monop_fn(const vm::command& com);
+bool is_opt_fn(const vm::bytecode& code, const vm::command& com);
+bool is_opt_monop_fn(const vm::bytecode& code, const vm::command& com);
 bool is_prim_push(const vm::command& com);
 bool is_side_effect_free(const vm::command& com);
 bool is_referentially_transparent(const vm::command& com);
 bool is_opt(const vm::command& com);
+bool may_call(const vm::command& com);
 bool is_noop(const vm::command& com);
 bool is_cjmp(const vm::command& com);
 bool is_ncjmp(const vm::command& com);
 bool is_jump(const vm::command& com);
+bool is_exit(const vm::command& com);
+
+size_t jump_target(size_t idx, const vm::command& com);
 
 vm::instruction instr_for(symbol sym);
 vm::instruction instr_for_monop(symbol sym);
 
+symbol method_name(const vm::bytecode& code, const vm::command& com);
+
 std::vector<size_t> jump_targets(const std::vector<vm::command>& code);
 
 bool is_eblk(const vm::command& com)
@@ -43,7 +56,8 @@ bool is_lblk(const vm::command& com)
 
 bool affects_env(const vm::command& com)
 {
-  return com.instr == vm::instruction::let || com.instr == vm::instruction::req;
+  return com.instr == vm::instruction::let || com.instr == vm::instruction::llet
+      || com.instr == vm::instruction::req || com.instr == vm::instruction::ptype;
 }
 
 bool uses_local_vars(const vm::command& com)
@@ -52,26 +66,32 @@ bool uses_local_vars(const vm::command& com)
       || com.instr == vm::instruction::write;
 }
 
+bool is_local_access(const vm::command& com)
+{
+  return com.instr == vm::instruction::llet || com.instr == vm::instruction::lread
+      || com.instr == vm::instruction::lwrite;
+}
+
 bool captures_local_env(const vm::command& com)
 {
   return com.instr == vm::instruction::pfn || com.instr == vm::instruction::ptype
       || com.instr == vm::instruction::pushc;
 }
 
-bool is_opt_fn(const vm::command& com)
+bool is_opt_fn(const vm::bytecode& code, const vm::command& com)
 {
   if (com.instr != vm::instruction::method)
     return false;
-  const auto sym = com.arg.as_sym();
+  const auto sym = method_name(code, com);
   return sym == builtin::sym::add   || sym == builtin::sym::subtract
       || sym == builtin::sym::times || sym == builtin::sym::divides;
 }
 
-bool is_opt_monop_fn(const vm::command& com)
+bool is_opt_monop_fn(const vm::bytecode& code, const vm::command& com)
 {
   if (com.instr != vm::instruction::method)
     return false;
-  const auto sym = com.arg.as_sym();
+  const auto sym = method_name(code, com);
   return sym == builtin::sym::op_not || sym == builtin::sym::size
       || sym == builtin::sym::get    || sym == builtin::sym::at_end
       || sym == builtin::sym::increment;
@@ -133,6 +153,27 @@ bool is_opt(const vm::command& com)
   }
 }
 
+// Whether com can end up calling arbitrary Vivaldi code (e.g. an overloaded
+// 'add' method)
+bool may_call(const vm::command& com)
+{
+  switch (com.instr) {
+  case vm::instruction::call:
+  case vm::instruction::itstart:
+  case vm::instruction::itnext:
+  case vm::instruction::opt_add:
+  case vm::instruction::opt_sub:
+  case vm::instruction::opt_mul:
+  case vm::instruction::opt_div:
+  case vm::instruction::opt_not:
+  case vm::instruction::opt_get:
+  case vm::instruction::opt_at_end:
+  case vm::instruction::opt_incr:
+  case vm::instruction::opt_size: return true;
+  default: return false;
+  }
+}
+
 bool is_noop(const vm::command& com)
 {
   return com.instr == vm::instruction::noop;
@@ -150,7 +191,19 @@ bool is_ncjmp(const vm::command& com)
 
 bool is_jump(const vm::command& com)
 {
-  return is_cjmp(com) || is_ncjmp(com);
+  return is_cjmp(com) || is_ncjmp(com) || com.instr == vm::instruction::itnext;
+}
+
+// Whether execution never continues past com (at least within the same code)
+bool is_exit(const vm::command& com)
+{
+  return com.instr == vm::instruction::ret || com.instr == vm::instruction::exc;
+}
+
+// Index of the instruction jumped to by com, the jump at idx
+size_t jump_target(size_t idx, const vm::command& com)
+{
+  return static_cast<size_t>(static_cast<int64_t>(idx) + 1 + com.as_int());
 }
 
 vm::instruction instr_for(symbol sym)
@@ -177,216 +230,380 @@ vm::instruction instr_for_monop(symbol sym)
   return vm::instruction::opt_size;
 }
 
+symbol method_name(const vm::bytecode& code, const vm::command& com)
+{
+  return code.constants.methods[com.as_const()].name;
+}
+
 std::vector<size_t> jump_targets(const std::vector<vm::command>& code)
 {
   std::vector<size_t> targets;
   for (size_t i{}; i != code.size(); ++i)
     if (is_jump(code[i]))
-      targets.push_back(i + 1 + code[i].arg.as_int());
+      targets.push_back(jump_target(i, code[i]));
   sort(begin(targets), end(targets));
   return targets;
 }
 
 // }}}
-// Optimization functions {{{
-
-bool optimize_blocks(std::vector<vm::command>& code);
-bool optimize_binops(std::vector<vm::command>& code);
-bool optimize_monops(std::vector<vm::command>& code);
-bool optimize_noops(std::vector<vm::command>& code);
-bool optimize_constants(std::vector<vm::command>& code);
-bool optimize_simple_vars(std::vector<vm::command>& code);
-bool optimize_tmp_methods(std::vector<vm::command>& code);
-bool optimize_abs_jumps(std::vector<vm::command>& code);
-bool optimize_cond_jumps(std::vector<vm::command>& code);
-bool optimize_noop_instrs(std::vector<vm::command>& code);
-
-bool optimize_lets(std::vector<vm::command>& code);
+// Peephole optimizations {{{
+
+// Rewrites of a few adjacent instructions at a time (e.g. folding constants, or
+// replacing method calls with specialized instructions), driven by a worklist.
+// Rewritten instructions are turned into noops rather than erased, and the
+// remaining (live) ones are kept in a doubly linked list so that noops can be
+// skipped over in constant time. Whenever something's rewritten only its
+// neighbors are revisited, so the whole thing runs in linear time, however many
+// rewrites end up enabling each other.
+class peephole {
+public:
+  peephole(vm::bytecode& bytecode);
+
+  // Applies every rewrite possible, and returns true if there were any.
+  bool run();
+
+private:
+  static const size_t npos = std::numeric_limits<size_t>::max();
+
+  vm::bytecode& m_bytecode;
+  std::vector<vm::command>& m_code;
+
+  // Previous and next live instruction of every live instruction, or npos.
+  std::vector<size_t> m_prev;
+  std::vector<size_t> m_next;
+  // No rewrite can span a jump target, since it can be reached from elsewhere
+  const std::vector<size_t> m_targets;
+
+  std::vector<size_t> m_work;
+  std::vector<bool> m_queued;
+
+  size_t prev(size_t idx) const { return idx == npos ? npos : m_prev[idx]; }
+  size_t next(size_t idx) const { return idx == npos ? npos : m_next[idx]; }
+
+  bool spans_target(size_t first, size_t last) const;
+  void kill(size_t idx);
+  void queue(size_t idx);
+  void revisit(size_t idx);
+  void revisit_gap(size_t before, size_t after);
+
+  bool rewrite_method(size_t idx);
+  bool rewrite_push(size_t idx);
+  bool rewrite_opt(size_t idx);
+  bool rewrite_cjmp(size_t idx);
+  bool rewrite_jump(size_t idx);
+};
+
+const size_t peephole::npos;
+
+peephole::peephole(vm::bytecode& bytecode)
+  : m_bytecode {bytecode},
+    m_code     {bytecode.commands},
+    m_prev     (m_code.size(), npos),
+    m_next     (m_code.size(), npos),
+    m_targets  {jump_targets(m_code)},
+    m_queued   (m_code.size(), false)
+{
+  auto last = npos;
+  for (size_t i{}; i != m_code.size(); ++i) {
+    if (is_noop(m_code[i]))
+      continue;
+    m_prev[i] = last;
+    if (last != npos)
+      m_next[last] = i;
+    last = i;
+  }
+}
 
-// Remove unnecessary 'eblk'/'lblk' pairs in which nothing is defined (since
-// creating a new environment is potentially expensive)
-bool optimize_blocks(std::vector<vm::command>& code)
+bool peephole::run()
 {
-  auto changed = false;
+  for (auto i = m_code.size(); i--;)
+    queue(i);
 
-  auto i = find_if(begin(code), end(code), is_eblk);
-  for (; i != end(code); i = find_if(i, end(code), is_eblk)) {
-    size_t imbalance = 1;
-    auto match = i;
-
-    while (imbalance) {
-      ++match;
-      if (is_eblk(*match))
-        ++imbalance;
-      else if (is_lblk(*match))
-        --imbalance;
+  auto changed = false;
+  while (!m_work.empty()) {
+    const auto idx = m_work.back();
+    m_work.pop_back();
+    m_queued[idx] = false;
+
+    const auto& com = m_code[idx];
+    if (com.instr == vm::instruction::method) {
+      if (rewrite_method(idx)) changed = true;
     }
-
-    if (none_of(i, match, affects_env)) {
-      changed = true;
-
-      i->instr = vm::instruction::noop;
-      match->instr = vm::instruction::noop;
+    else if (is_side_effect_free(com)) {
+      if (rewrite_push(idx))   changed = true;
+    }
+    else if (is_opt(com)) {
+      if (rewrite_opt(idx))    changed = true;
+    }
+    else if (is_cjmp(com) || is_ncjmp(com)) {
+      if (rewrite_cjmp(idx) || rewrite_jump(idx)) changed = true;
     }
-    ++i;
   }
   return changed;
 }
 
-// Replace calls to 'add', 'subtract', etc. with optimized instructions
-bool optimize_binops(std::vector<vm::command>& code)
+// Checks if any instruction after first, up to and including last, is a jump
+// target
+bool peephole::spans_target(size_t first, size_t last) const
 {
-  auto changed = false;
+  const auto target = upper_bound(begin(m_targets), end(m_targets), first);
+  return target != end(m_targets) && *target <= last;
+}
 
-  auto i = find_if(begin(code), end(code), is_opt_fn);
-  for (; i != end(code); i = find_if(i, end(code), is_opt_fn)) {
-    const auto next = find_if_not(i + 1, end(code), is_noop);
-    if (next != end(code)) {
-      if (next->instr == vm::instruction::call && next->arg.as_int() == 1) {
-        changed = true;
+void peephole::kill(size_t idx)
+{
+  m_code[idx].instr = vm::instruction::noop;
+  m_code[idx].arg = 0;
+  if (m_prev[idx] != npos)
+    m_next[m_prev[idx]] = m_next[idx];
+  if (m_next[idx] != npos)
+    m_prev[m_next[idx]] = m_prev[idx];
+}
 
-        i->instr = instr_for(i->arg.as_sym());
-        i->arg = {};
-        next->instr = vm::instruction::noop;
-        next->arg = {};
-      }
-    }
-    i = next;
+void peephole::queue(size_t idx)
+{
+  if (idx != npos && !m_queued[idx] && !is_noop(m_code[idx])) {
+    m_queued[idx] = true;
+    m_work.push_back(idx);
   }
-  return changed;
 }
 
-// Replace calls to 'not', 'size', etc. with optimized instructions
-bool optimize_monops(std::vector<vm::command>& code)
+// Queues the live instruction idx, along with every instruction whose rewrites
+// could involve it (no rewrite looks at more than three instructions)
+void peephole::revisit(size_t idx)
 {
-  auto changed = false;
+  queue(idx);
+  queue(prev(idx));
+  queue(prev(prev(idx)));
+  queue(next(idx));
+  queue(next(next(idx)));
+}
 
-  auto i = find_if(begin(code), end(code), is_opt_monop_fn);
-  for (; i != end(code); i = find_if(i, end(code), is_opt_monop_fn)) {
-    const auto next = find_if_not(i + 1, end(code), is_noop);
-    if (next != end(code)) {
-      if (next->instr == vm::instruction::call && next->arg.as_int() == 0) {
-        changed = true;
+// Revisits the instructions on either side of a run that's just been killed
+void peephole::revisit_gap(size_t before, size_t after)
+{
+  if (before != npos)
+    revisit(before);
+  else if (after != npos)
+    revisit(after);
+}
 
-        i->instr = instr_for_monop(i->arg.as_sym());
-        i->arg = {};
-        next->instr = vm::instruction::noop;
-        next->arg = {};
-      }
-    }
-    i = next;
+// Replace calls to 'add', 'not', etc. with optimized instructions, and any
+// other direct method call with opt_tmpm
+bool peephole::rewrite_method(size_t idx)
+{
+  const auto call = next(idx);
+  if (call == npos || m_code[call].instr != vm::instruction::call
+                   || spans_target(idx, call))
+    return false;
+
+  auto& com = m_code[idx];
+  const auto argc = m_code[call].as_int();
+  if (argc == 1 && is_opt_fn(m_bytecode, com)) {
+    com.instr = instr_for(method_name(m_bytecode, com));
   }
-  return changed;
+  else if (argc == 0 && is_opt_monop_fn(m_bytecode, com)) {
+    com.instr = instr_for_monop(method_name(m_bytecode, com));
+  }
+  else {
+    com.instr = vm::instruction::opt_tmpm;
+    return true;
+  }
+  com.arg = 0;
+  kill(call);
+  revisit(idx);
+  return true;
 }
 
 // Remove 'push literal' / 'pop literal'
-bool optimize_noops(std::vector<vm::command>& code)
+bool peephole::rewrite_push(size_t idx)
 {
-  const auto immut = jump_targets(code);
+  const auto pop = next(idx);
+  if (pop == npos || m_code[pop].instr != vm::instruction::pop
+                  || m_code[pop].as_int() != 1
+                  || spans_target(idx, pop))
+    return false;
 
-  auto changed = false;
+  const auto before = prev(idx);
+  const auto after = next(pop);
+  kill(idx);
+  kill(pop);
+  revisit_gap(before, after);
+  return true;
+}
 
-  auto i = find_if(begin(code), end(code), is_side_effect_free);
-  for (; i != end(code); i = find_if(i, end(code), is_side_effect_free)) {
-    const auto next = i + 1;
-    if (next != end(code) &&
-        !binary_search(begin(immut), end(immut), i    - begin(code)) &&
-        !binary_search(begin(immut), end(immut), next - begin(code))) {
-      if (next->instr == vm::instruction::pop && next->arg.as_int() == 1) {
-        changed = true;
+// Expression folding--- e.g. convert '1 + 2 * 3 - 5' to just '2'
+bool peephole::rewrite_opt(size_t idx)
+{
+  const auto a1 = prev(idx);
+  const auto a2 = prev(a1);
+  if (a2 == npos || m_code[a1].instr != vm::instruction::pint
+                 || m_code[a2].instr != vm::instruction::pint
+                 || spans_target(a2, idx))
+    return false;
 
-        i->instr = vm::instruction::noop;
-        i->arg = {};
-        next->instr = vm::instruction::noop;
-        next->arg = {};
-      }
-    }
-    ++i;
+  value::integer result;
+  const value::integer val1 = m_code[a1].as_int();
+  const value::integer val2 = m_code[a2].as_int();
+  switch (m_code[idx].instr) {
+  case vm::instruction::opt_add: result = val1 + val2; break;
+  case vm::instruction::opt_sub: result = val1 - val2; break;
+  case vm::instruction::opt_mul: result = val1 * val2; break;
+  default:
+    // Leave division by zero to throw at runtime
+    if (val2 == 0)
+      return false;
+    result = val1 / val2;
+    break;
   }
-  return changed;
+  // Results too big to be stored inline would need to go in the constant
+  // pool; just leave them to be computed at runtime
+  if (result != static_cast<int32_t>(result))
+    return false;
+
+  m_code[idx].instr = vm::instruction::pint;
+  m_code[idx].arg = static_cast<int32_t>(result);
+  kill(a1);
+  kill(a2);
+  revisit(idx);
+  return true;
 }
 
-// Expression folding--- e.g. convert '1 + 2 * 3 - 5' to just '2'
-bool optimize_constants(std::vector<vm::command>& code)
+// Replace conditional jumps (jf, jt) with absolute jump (jmp) if the condition
+// is a literal and so known at compile time
+bool peephole::rewrite_cjmp(size_t idx)
 {
-  auto changed = false;
-
-  auto i = find_if(begin(code), end(code), is_opt);
-  for (; i != end(code); i = find_if(i, end(code), is_opt)) {
-    if (i - begin(code) > 1) {
-      const auto a2 = i - 2;
-      const auto a1 = i - 1;
-      if (a2->instr == vm::instruction::pint && a1->instr == vm::instruction::pint) {
-        changed = true;
+  if (!is_cjmp(m_code[idx]))
+    return false;
+  const auto condition = prev(idx);
+  if (condition == npos || !is_prim_push(m_code[condition])
+                        || spans_target(condition, idx))
+    return false;
 
-        value::integer result;
-        const auto val1 = a1->arg.as_int();
-        const auto val2 = a2->arg.as_int();
-        switch (i->instr) {
-        case vm::instruction::opt_add: result = val1 + val2; break;
-        case vm::instruction::opt_sub: result = val1 - val2; break;
-        case vm::instruction::opt_mul: result = val1 * val2; break;
-        default:                       result = val1 / val2; break;
-        }
-        i->instr = vm::instruction::pint;
-        i->arg = result;
-        a1->instr = vm::instruction::noop;
-        a2->instr = vm::instruction::noop;
-        a1->arg = {};
-        a2->arg = {};
-      }
-    }
-    ++i;
+  bool truthiness;
+  switch (m_code[condition].instr) {
+  case vm::instruction::pnil:  truthiness = false;                         break;
+  case vm::instruction::pbool: truthiness = m_code[condition].as_bool(); break;
+  default:                     truthiness = true;                          break;
   }
-  return changed;
+  const auto jumps = truthiness == (m_code[idx].instr == vm::instruction::jt);
+  if (jumps)
+    m_code[idx].instr = vm::instruction::jmp;
+  else
+    kill(idx);
+  revisit(condition);
+  return true;
 }
 
-// If possible, replace variables with simple, unique instructions (int, bool,
-// and nil literals, as well as 'arg' instructions) with the literal value
-bool optimize_simple_vars(std::vector<vm::command>& code)
+// Remove jumps to the very next instruction (none of them pop anything, so
+// they're no different from noops)
+bool peephole::rewrite_jump(size_t idx)
 {
-  if (any_of(begin(code), end(code), is_jump))
+  const auto target = jump_target(idx, m_code[idx]);
+  const auto following = next(idx);
+  if (target <= idx || (following != npos && following < target))
     return false;
-  const auto in_closure = any_of(begin(code), end(code), captures_local_env);
 
-  std::unordered_map<vv::symbol, vm::command> values;
+  kill(idx);
+  revisit_gap(prev(idx), following);
+  return true;
+}
 
+// }}}
+// Whole-code optimizations {{{
+
+bool optimize_blocks(std::vector<vm::command>& code);
+bool optimize_jump_chains(std::vector<vm::command>& code);
+bool optimize_lets(std::vector<vm::command>& code);
+bool remove_noops(std::vector<vm::command>& code);
+
+// Remove unnecessary 'eblk'/'lblk' pairs in which nothing is defined (since
+// creating a new environment is potentially expensive). Blocks containing any
+// local variable access or closure are kept too, since removing a block would
+// change the depth of every environment it encloses.
+//
+// Of the blocks that are kept, those whose environment nothing can keep a
+// reference to (i.e. that create no closures, and require no files, since
+// loaded code runs in a closure) are marked as such on their 'lblk', so their
+// environments can be reused instead of allocating one each time a loop body's
+// entered. Creating a closure captures every enclosing block as well, so it
+// marks every open block, and each block starts out marked if the block it's
+// in already is; that way, a block left without an 'lblk' (because it always
+// returns) can't make its enclosing block look uncaptured.
+bool optimize_blocks(std::vector<vm::command>& code)
+{
+  struct open_block {
+    size_t start;
+    // Whether anything in the block (or in any block nested in it) so far
+    // needs it to stay
+    bool needed;
+    // Whether anything so far might have kept a reference to its environment
+    bool captured;
+  };
+  // Every block entered but not yet left
+  std::vector<open_block> open;
   auto changed = false;
 
-  for (auto i = begin(code); i != end(code); ++i) {
-    if (is_referentially_transparent(*i)) {
-      const auto next = std::next(i);
-      if (next != end(code)) {
-        if (next->instr == vm::instruction::let) {
-          values[next->arg.as_sym()] = *i;
-          i = next;
-        }
-      }
-    }
-    else if (i->instr == vm::instruction::req) {
-      return changed;
+  for (size_t i{}; i != code.size(); ++i) {
+    if (is_eblk(code[i])) {
+      open.push_back({i, false, !open.empty() && open.back().captured});
+      continue;
     }
-    else if ((i->instr == vm::instruction::let || i->instr == vm::instruction::write)) {
-      values.erase(i->arg.as_sym());
+    if (open.empty())
+      continue;
+
+    if (captures_local_env(code[i]) || code[i].instr == vm::instruction::req) {
+      for (auto& block : open)
+        block.captured = true;
     }
-    else if (in_closure && i->instr == vm::instruction::call) {
-      values.clear();
+
+    if (affects_env(code[i]) || is_local_access(code[i])
+                             || captures_local_env(code[i])) {
+      open.back().needed = true;
     }
-    else if (i->instr == vm::instruction::read && values.count(i->arg.as_sym())) {
-      *i = values[i->arg.as_sym()];
-      changed = true;
+    else if (is_lblk(code[i])) {
+      const auto block = open.back();
+      open.pop_back();
+      if (block.needed) {
+        if (!open.empty())
+          open.back().needed = true;
+        if (code[i].as_bool() == block.captured) {
+          changed = true;
+          code[i].arg = !block.captured;
+        }
+      }
+      else {
+        changed = true;
+        code[block.start].instr = vm::instruction::noop;
+        code[i].instr = vm::instruction::noop;
+      }
     }
   }
   return changed;
 }
 
-bool optimize_tmp_methods(std::vector<vm::command>& code)
+// Retarget jumps to unconditional jumps (e.g. the jump to the end of an
+// inner loop's enclosing conditional) straight at their final destination
+bool optimize_jump_chains(std::vector<vm::command>& code)
 {
   auto changed = false;
-  for (auto i = begin(code); i != end(code) - 1; ++i) {
-    if (i->instr == vm::instruction::method && i[1].instr == vm::instruction::call) {
-      i->instr = vm::instruction::opt_tmpm;
+  for (size_t i{}; i != code.size(); ++i) {
+    if (!is_jump(code[i]))
+      continue;
+
+    auto target = jump_target(i, code[i]);
+    // Give up on long chains, which are either very rare or an infinite loop
+    for (auto hops = 0; hops != 8 && target < code.size() && is_ncjmp(code[target]); ++hops) {
+      const auto next_target = jump_target(target, code[target]);
+      if (next_target == target)
+        break;
+      target = next_target;
+    }
+
+    const auto offset = static_cast<int32_t>(target) - static_cast<int32_t>(i) - 1;
+    if (offset != code[i].as_int()) {
       changed = true;
+      code[i].arg = offset;
     }
   }
   return changed;
@@ -398,134 +615,717 @@ bool optimize_lets(std::vector<vm::command>& code)
   if (any_of(begin(code), end(code), captures_local_env))
     return false;
 
+  // Every variable used anywhere after the current instruction
+  std::unordered_set<symbol> used;
   auto changed = false;
-  for (auto i = begin(code); i != end(code); ++i) {
-    if (i->instr == vm::instruction::let) {
-      const auto used = any_of(std::next(i), end(code), [&](const auto& c)
-      {
-        return uses_local_vars(c) && c.arg.as_sym() == i->arg.as_sym();
-      });
-      if (!used) {
-        changed = true;
-        i->instr = vm::instruction::noop;
-      }
+  for (auto i = code.rbegin(); i != code.rend(); ++i) {
+    if (!uses_local_vars(*i))
+      continue;
+    if (i->instr == vm::instruction::let && !used.count(i->as_sym())) {
+      changed = true;
+      i->instr = vm::instruction::noop;
     }
+    used.insert(i->as_sym());
   }
   return changed;
 }
 
-// Replace conditional jumps (jf, jt) with absolute jump (jmp) if the condition
-// is a literal and so known at compile time
-bool optimize_cond_jumps(std::vector<vm::command>& code)
+// Remove noop instructions created during optimization, relocating jumps to
+// match
+bool remove_noops(std::vector<vm::command>& code)
 {
-  auto changed = false;
+  // Index of every instruction once the noops before it are gone (noops
+  // themselves get the index of the next instruction, which is where any jumps
+  // to them will end up)
+  std::vector<size_t> new_idx(code.size() + 1);
+  size_t live{};
+  for (size_t i{}; i != code.size(); ++i) {
+    new_idx[i] = live;
+    if (!is_noop(code[i]))
+      ++live;
+  }
+  new_idx[code.size()] = live;
+  if (live == code.size())
+    return false;
+
+  for (size_t i{}; i != code.size(); ++i) {
+    if (is_jump(code[i])) {
+      const auto target = new_idx[jump_target(i, code[i])];
+      code[i].arg = static_cast<int32_t>(target) - static_cast<int32_t>(new_idx[i]) - 1;
+    }
+  }
+  code.erase(remove_if(begin(code), end(code), is_noop), end(code));
+  return true;
+}
+
+// }}}
+// Control flow {{{
+
+// Local variables, as identified by the block nesting level (relative to the
+// start of the code being optimized) of the environment they're in, and their
+// slot. Those at negative levels belong to enclosing functions.
+using local_key = std::pair<int32_t, int32_t>;
+
+// A run of instructions that's only ever entered at its first, and only ever
+// left after its last.
+struct basic_block {
+  size_t first;
+  size_t last;
+  std::vector<size_t> successors;
+  std::vector<size_t> predecessors;
+};
+
+// The basic blocks of a piece of code, and the jumps and fallthroughs between
+// them. Exceptions are ignored, since they always leave the code entirely (any
+// catcher in the same function is compiled as a function of its own).
+class flow_graph {
+public:
+  explicit flow_graph(const std::vector<vm::command>& code);
+
+  std::vector<basic_block> blocks;
+  // Whether each block can be reached from the start of the code.
+  std::vector<bool> reachable;
+};
+
+flow_graph::flow_graph(const std::vector<vm::command>& code)
+{
+  std::vector<bool> leader(code.size() + 1, false);
+  leader[0] = true;
+  for (size_t i{}; i != code.size(); ++i) {
+    if (is_jump(code[i]))
+      leader[jump_target(i, code[i])] = true;
+    if (is_jump(code[i]) || is_exit(code[i]))
+      leader[i + 1] = true;
+  }
 
-  const auto immut = jump_targets(code);
+  std::vector<size_t> block_at(code.size() + 1, std::numeric_limits<size_t>::max());
+  for (size_t i{}; i != code.size(); ++i) {
+    if (leader[i]) {
+      block_at[i] = blocks.size();
+      blocks.push_back({i, i, {}, {}});
+    }
+    blocks.back().last = i + 1;
+  }
 
-  auto i = find_if(++begin(code), end(code), is_cjmp);
-  for (; i != end(code); i = find_if(i, end(code), is_cjmp)) {
-    const auto condition = i - 1;
-    if (is_prim_push(*condition) &&
-        !binary_search(begin(immut), end(immut), i         - begin(code)) &&
-        !binary_search(begin(immut), end(immut), condition - begin(code))) {
+  const auto link = [&](const size_t from, const size_t to_idx)
+  {
+    // Jumping or falling off the end just leaves the code
+    if (to_idx == code.size())
+      return;
+    const auto to = block_at[to_idx];
+    blocks[from].successors.push_back(to);
+    blocks[to].predecessors.push_back(from);
+  };
+  for (size_t i{}; i != blocks.size(); ++i) {
+    const auto end = blocks[i].last - 1;
+    if (is_jump(code[end]))
+      link(i, jump_target(end, code[end]));
+    if (!is_ncjmp(code[end]) && !is_exit(code[end]))
+      link(i, blocks[i].last);
+  }
 
-      changed = true;
-      bool truthiness;
-      switch (condition->instr) {
-      case vm::instruction::pnil:  truthiness = false;                    break;
-      case vm::instruction::pbool: truthiness = condition->arg.as_bool(); break;
-      default:                     truthiness = true;                     break;
+  reachable.assign(blocks.size(), false);
+  if (blocks.empty())
+    return;
+  std::vector<size_t> work{0};
+  reachable[0] = true;
+  while (!work.empty()) {
+    const auto block = work.back();
+    work.pop_back();
+    for (const auto i : blocks[block].successors) {
+      if (!reachable[i]) {
+        reachable[i] = true;
+        work.push_back(i);
       }
-      if (i->instr == vm::instruction::jf) {
-        i->instr = truthiness ? vm::instruction::noop : vm::instruction::jmp;
+    }
+  }
+}
+
+// What's known about a local variable at some point in the code: whether it's
+// been initialized, and, if it holds a value that's cheaper to recompute than
+// to look up (see is_referentially_transparent), what that is.
+struct var_info {
+  bool inited{false};
+  bool maybe_inited{false};
+  // A noop if the value isn't known
+  vm::command value{vm::instruction::noop};
+};
+
+// What's known about every variable at some point in the code; local
+// variables are indexed as in var_analysis::m_keys.
+struct var_state {
+  std::vector<var_info> locals;
+  std::unordered_map<symbol, vm::command> named;
+};
+
+// Whether a local variable is used after some point in the code: either read,
+// or touched at all (any access can tell whether a variable's been initialized,
+// since 'llet' throws if it has, and 'lread' and 'lwrite' fall back to
+// looking variables up by name if it hasn't).
+struct var_use {
+  bool read{false};
+  bool touched{false};
+};
+
+// Basic blocks waiting to be visited, which can be taken in either code order
+// or reverse code order.
+class block_queue {
+public:
+  explicit block_queue(size_t size);
+
+  bool empty() const { return m_size == 0; }
+  void push(size_t block);
+  size_t pop_front();
+  size_t pop_back();
+
+private:
+  std::vector<char> m_queued;
+  size_t m_size;
+  // Every queued block is in [m_low, m_high)
+  size_t m_low;
+  size_t m_high;
+};
+
+block_queue::block_queue(const size_t size)
+  : m_queued (size, false),
+    m_size   {0},
+    m_low    {size},
+    m_high   {0}
+{ }
+
+void block_queue::push(const size_t block)
+{
+  if (m_queued[block])
+    return;
+  m_queued[block] = true;
+  ++m_size;
+  m_low = std::min(m_low, block);
+  m_high = std::max(m_high, block + 1);
+}
+
+size_t block_queue::pop_front()
+{
+  while (!m_queued[m_low])
+    ++m_low;
+  m_queued[m_low] = false;
+  --m_size;
+  return m_low;
+}
+
+size_t block_queue::pop_back()
+{
+  while (!m_queued[m_high - 1])
+    --m_high;
+  m_queued[m_high - 1] = false;
+  --m_size;
+  return m_high - 1;
+}
+
+// Data-flow analysis of the variables in a piece of code, used to replace reads
+// of variables with known values by the values themselves (including in loops
+// and conditionals), and to remove stores that are never read.
+class var_analysis {
+public:
+  var_analysis(vm::bytecode& bytecode, const flow_graph& graph);
+
+  // Returns true if any variable reads were replaced.
+  bool propagate_values();
+  // Returns true if any stores were removed.
+  bool remove_dead_stores();
+
+private:
+  vm::bytecode& m_bytecode;
+  std::vector<vm::command>& m_code;
+  const flow_graph& m_graph;
+
+  // If a closure's capturing the local environment, calling anything could
+  // change any variable
+  const bool m_in_closure;
+  // 'require' can define (or, through functions it defines, change) variables
+  // by name, so they're only tracked in code without it
+  const bool m_track_named;
+  // Whether every path into each block agrees on how deeply nested it is (which
+  // should always be the case for generated code)
+  bool m_consistent;
+
+  // Block nesting level of each instruction
+  std::vector<int32_t> m_level;
+  // Every local variable accessed in the code, and the index in it of the one
+  // each local variable access refers to
+  std::vector<local_key> m_keys;
+  std::vector<size_t> m_var;
+  // State on entry to each basic block, with every block's local variables
+  // stored one after another
+  std::vector<char> m_reached;
+  std::vector<var_info> m_entry_locals;
+  std::vector<std::unordered_map<symbol, vm::command>> m_entry_named;
+  // For each 'llet', whether its variable's definitely not initialized yet; for
+  // each 'lwrite', whether it definitely is (in either case, whether removing
+  // it can't change whether anything's thrown, or which variable's written)
+  std::vector<char> m_safe_store;
+  // Whether each store can be removed, since it's never read afterwards
+  std::vector<char> m_dead_store;
+
+  bool find_levels();
+  void find_vars();
+  void load_entry(var_state& state, size_t block) const;
+  bool meet(size_t block, const var_state& from);
+  void step(var_state& state, size_t idx, size_t first);
+  void step_back(std::vector<var_use>& uses, size_t idx);
+};
+
+var_analysis::var_analysis(vm::bytecode& bytecode, const flow_graph& graph)
+  : m_bytecode    {bytecode},
+    m_code        {bytecode.commands},
+    m_graph       {graph},
+    m_in_closure  {any_of(begin(m_code), end(m_code), captures_local_env)},
+    m_track_named {none_of(begin(m_code), end(m_code),
+                           [](const auto& c) { return c.instr == vm::instruction::req; })},
+    m_consistent  {false},
+    m_level       (m_code.size()),
+    m_var         (m_code.size()),
+    m_reached     (graph.blocks.size(), false),
+    m_entry_named (graph.blocks.size()),
+    m_safe_store  (m_code.size(), false),
+    m_dead_store  (m_code.size(), false)
+{
+  const auto& blocks = m_graph.blocks;
+  if (blocks.empty() || !find_levels())
+    return;
+  m_consistent = true;
+  find_vars();
+  m_entry_locals.resize(blocks.size() * m_keys.size());
+
+  // Blocks are visited in code order, which (since the only backwards jumps are
+  // to the start of loops) means a loop body's only revisited once per loop
+  // it's in. A block's always visited again if its entry state changes, so
+  // anything step records about each instruction is from the final state.
+  m_reached[0] = true;
+  block_queue work{blocks.size()};
+  work.push(0);
+  var_state state;
+  while (!work.empty()) {
+    const auto block = work.pop_front();
+    load_entry(state, block);
+    for (auto i = blocks[block].first; i != blocks[block].last; ++i)
+      step(state, i, blocks[block].first);
+    for (const auto i : blocks[block].successors) {
+      if (meet(i, state))
+        work.push(i);
+    }
+  }
+}
+
+bool var_analysis::propagate_values()
+{
+  if (!m_consistent)
+    return false;
+
+  auto changed = false;
+  const auto& blocks = m_graph.blocks;
+  var_state state;
+  for (size_t block{}; block != blocks.size(); ++block) {
+    if (!m_graph.reachable[block])
+      continue;
+    load_entry(state, block);
+    for (auto i = blocks[block].first; i != blocks[block].last; ++i) {
+      auto& com = m_code[i];
+      if (com.instr == vm::instruction::lread) {
+        const auto& known = state.locals[m_var[i]].value;
+        if (!is_noop(known)) {
+          com = known;
+          changed = true;
+        }
       }
-      else {
-        i->instr = truthiness ? vm::instruction::jmp : vm::instruction::noop;
+      else if (com.instr == vm::instruction::read) {
+        const auto known = state.named.find(com.as_sym());
+        if (known != end(state.named)) {
+          com = known->second;
+          changed = true;
+        }
       }
+      step(state, i, blocks[block].first);
     }
-    ++i;
   }
   return changed;
 }
 
-// remove code that's never reached because it's always jumped over (most useful
-// in conjunction with optimize_cond_jumps)
-bool optimize_abs_jumps(std::vector<vm::command>& code)
+bool var_analysis::remove_dead_stores()
 {
-  if (any_of(begin(code), end(code), is_cjmp))
+  // Locals can be read after the code's finished if they're captured, or if
+  // they're copied out to the caller (as a required file's are)
+  if (!m_consistent || m_in_closure || !m_track_named || m_keys.empty())
     return false;
-  if (any_of(begin(code), end(code),
-             [](const auto& c) { return is_ncjmp(c) && c.arg.as_int() < 0; }))
+  if (any_of(begin(m_code), end(m_code), [](const auto& c)
+             { return c.instr == vm::instruction::ret && c.as_bool(); }))
     return false;
 
-  auto i = find_if(begin(code), end(code), is_ncjmp);
-  if (i == end(code))
-    return false;
+  const auto& blocks = m_graph.blocks;
+  const auto vars = m_keys.size();
+  // Uses on entry to each block, stored one block after another
+  std::vector<var_use> entry(blocks.size() * vars);
+  std::vector<var_use> uses(vars);
+
+  // Visited in reverse code order, for the same reason the forward analysis
+  // goes in code order (and, likewise, every store's last marked as dead or not
+  // from the final state)
+  block_queue work{blocks.size()};
+  for (size_t i{}; i != blocks.size(); ++i) {
+    if (m_graph.reachable[i])
+      work.push(i);
+  }
+  while (!work.empty()) {
+    const auto block = work.pop_back();
+
+    fill(begin(uses), end(uses), var_use{});
+    for (const auto i : blocks[block].successors) {
+      for (size_t j{}; j != vars; ++j) {
+        uses[j].read |= entry[i * vars + j].read;
+        uses[j].touched |= entry[i * vars + j].touched;
+      }
+    }
+    for (auto i = blocks[block].last; i-- != blocks[block].first;)
+      step_back(uses, i);
+
+    const auto block_entry = begin(entry) + static_cast<ptrdiff_t>(block * vars);
+    const auto same = [](const var_use& lhs, const var_use& rhs)
+    {
+      return lhs.read == rhs.read && lhs.touched == rhs.touched;
+    };
+    if (!std::equal(begin(uses), end(uses), block_entry, same)) {
+      copy(begin(uses), end(uses), block_entry);
+      for (const auto i : blocks[block].predecessors) {
+        if (m_graph.reachable[i])
+          work.push(i);
+      }
+    }
+  }
 
-  for (; i != end(code); i = find_if(i, end(code), is_ncjmp)) {
-    if (i->arg.as_int() >= 0)
-      i = code.erase(i, i + 1 + i->arg.as_int());
+  // The stored value's left on the stack either way, so the store itself can
+  // just be dropped
+  auto changed = false;
+  for (size_t i{}; i != m_code.size(); ++i) {
+    if (m_dead_store[i]) {
+      m_code[i].instr = vm::instruction::noop;
+      m_code[i].arg = 0;
+      changed = true;
+    }
   }
-  return true;
+  return changed;
 }
 
-// Remove noop instructions created during optimization, unless they're needed
-// to ensure that jump indices are correct
-bool optimize_noop_instrs(std::vector<vm::command>& code)
+// Finds the nesting level of every reachable instruction, and returns false if
+// any block can be entered at more than one
+bool var_analysis::find_levels()
 {
-  if (any_of(begin(code), end(code), is_jump))
-    return false;
+  const auto& blocks = m_graph.blocks;
+  std::vector<int32_t> entry(blocks.size());
+  std::vector<char> seen(blocks.size(), false);
+  std::vector<size_t> work{0};
+  seen[0] = true;
+  while (!work.empty()) {
+    const auto block = work.back();
+    work.pop_back();
+
+    auto level = entry[block];
+    for (auto i = blocks[block].first; i != blocks[block].last; ++i) {
+      m_level[i] = level;
+      if (is_eblk(m_code[i]))
+        ++level;
+      else if (is_lblk(m_code[i]))
+        --level;
+    }
+    for (const auto i : blocks[block].successors) {
+      if (!seen[i]) {
+        seen[i] = true;
+        entry[i] = level;
+        work.push_back(i);
+      }
+      else if (entry[i] != level) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
 
-  const auto last_valid = remove_if(begin(code), end(code), is_noop);
-  if (last_valid != end(code)) {
-    code.erase(last_valid, end(code));
-    return true;
+// Numbers every local variable accessed in reachable code, so what's known
+// about them can be kept in flat arrays
+void var_analysis::find_vars()
+{
+  // Keyed by level and slot, packed together
+  hash_map<uint64_t, size_t> ids;
+  for (size_t block{}; block != m_graph.blocks.size(); ++block) {
+    if (!m_graph.reachable[block])
+      continue;
+    for (auto i = m_graph.blocks[block].first; i != m_graph.blocks[block].last; ++i) {
+      if (!is_local_access(m_code[i]))
+        continue;
+      const auto& var = m_bytecode.constants.locals[m_code[i].as_const()];
+      const local_key key{m_level[i] - var.depth, var.slot};
+      const auto packed = static_cast<uint64_t>(static_cast<uint32_t>(key.first)) << 32
+                        | static_cast<uint32_t>(key.second);
+      const auto found = ids.find(packed);
+      if (found != ids.end()) {
+        m_var[i] = found->second;
+      }
+      else {
+        m_var[i] = m_keys.size();
+        ids.insert(packed, m_keys.size());
+        m_keys.push_back(key);
+      }
+    }
   }
-  return false;
 }
 
-// }}}
+void var_analysis::load_entry(var_state& state, const size_t block) const
+{
+  const auto first = begin(m_entry_locals) + static_cast<ptrdiff_t>(block * m_keys.size());
+  state.locals.assign(first, first + static_cast<ptrdiff_t>(m_keys.size()));
+  state.named = m_entry_named[block];
+}
 
-bool optimize_once(std::vector<vm::command>& code)
+// Merges what's known on another path into a block into what's known on entry
+// to it, and returns true if that changed anything
+bool var_analysis::meet(const size_t block, const var_state& from)
 {
-  auto changed = false;
-  if (optimize_blocks(code))      changed = true;
-  if (optimize_binops(code))      changed = true;
-  if (optimize_monops(code))      changed = true;
-  if (optimize_noops(code))       changed = true;
-  if (optimize_constants(code))   changed = true;
-  if (optimize_simple_vars(code)) changed = true;
-  if (optimize_tmp_methods(code)) changed = true;
-  if (optimize_cond_jumps(code))  changed = true;
-  if (optimize_abs_jumps(code))   changed = true;
-  if (optimize_noop_instrs(code)) changed = true;
+  const auto into = begin(m_entry_locals) + static_cast<ptrdiff_t>(block * m_keys.size());
+  auto& named = m_entry_named[block];
+  if (!m_reached[block]) {
+    m_reached[block] = true;
+    copy(begin(from.locals), end(from.locals), into);
+    named = from.named;
+    return true;
+  }
 
+  const auto same = [](const vm::command& lhs, const vm::command& rhs)
+  {
+    return lhs.instr == rhs.instr && lhs.arg == rhs.arg;
+  };
+
+  auto changed = false;
+  for (size_t i{}; i != m_keys.size(); ++i) {
+    auto& var = into[static_cast<ptrdiff_t>(i)];
+    const auto& other = from.locals[i];
+    if (var.inited && !other.inited) {
+      var.inited = false;
+      changed = true;
+    }
+    if (!var.maybe_inited && other.maybe_inited) {
+      var.maybe_inited = true;
+      changed = true;
+    }
+    if (!is_noop(var.value) && !same(var.value, other.value)) {
+      var.value = {vm::instruction::noop};
+      changed = true;
+    }
+  }
+  for (auto i = begin(named); i != end(named);) {
+    const auto other = from.named.find(i->first);
+    if (other != end(from.named) && same(other->second, i->second)) {
+      ++i;
+    }
+    else {
+      i = named.erase(i);
+      changed = true;
+    }
+  }
   return changed;
 }
 
-bool optimize_independent_once(std::vector<vm::command>& code)
+// Updates state to reflect the instruction at idx, in the basic block starting
+// at first, having been run (and notes whether it's a safe store)
+void var_analysis::step(var_state& state, const size_t idx, const size_t first)
 {
-  auto changed = false;
+  const auto& com = m_code[idx];
+  // The value being stored, if com's a store and it's known
+  const auto value = [&]
+  {
+    return idx != first && is_referentially_transparent(m_code[idx - 1])
+         ? &m_code[idx - 1] : nullptr;
+  };
+  // Forgets everything about the variables at or below level, which are gone
+  // once it's left, and new once it's entered
+  const auto forget_level = [&](const int32_t level)
+  {
+    for (size_t i{}; i != m_keys.size(); ++i) {
+      if (m_keys[i].first >= level)
+        state.locals[i] = {};
+    }
+  };
 
-  if (optimize_lets(code)) changed = true;
+  switch (com.instr) {
+  case vm::instruction::eblk:
+    forget_level(m_level[idx] + 1);
+    break;
+
+  case vm::instruction::lblk:
+    forget_level(m_level[idx]);
+    break;
+
+  case vm::instruction::llet: {
+    auto& var = state.locals[m_var[idx]];
+    m_safe_store[idx] = !var.maybe_inited;
+    var.inited = true;
+    var.maybe_inited = true;
+    if (m_keys[m_var[idx]].first >= 0 && value())
+      var.value = *value();
+    else
+      var.value = {vm::instruction::noop};
+    break;
+  }
 
-  return changed;
+  case vm::instruction::lwrite: {
+    auto& var = state.locals[m_var[idx]];
+    m_safe_store[idx] = var.inited;
+    // If the variable isn't initialized, it's written by name instead
+    if (!var.inited)
+      state.named.erase(m_bytecode.constants.locals[com.as_const()].name);
+    if (m_keys[m_var[idx]].first >= 0 && var.inited && value())
+      var.value = *value();
+    else
+      var.value = {vm::instruction::noop};
+    break;
+  }
+
+  case vm::instruction::let:
+    if (m_track_named && m_level[idx] == 0 && value())
+      state.named[com.as_sym()] = *value();
+    else
+      state.named.erase(com.as_sym());
+    break;
+
+  case vm::instruction::write:
+    if (m_track_named && m_level[idx] == 0 && state.named.count(com.as_sym()) && value())
+      state.named[com.as_sym()] = *value();
+    else
+      state.named.erase(com.as_sym());
+    break;
+
+  case vm::instruction::ptype:
+    state.named.clear();
+    break;
+
+  default:
+    if (m_in_closure && may_call(com)) {
+      for (auto& i : state.locals)
+        i.value = {vm::instruction::noop};
+      state.named.clear();
+    }
+  }
 }
 
+// Updates uses to reflect what's used before the instruction at idx, rather than
+// after it (and notes whether it's a store that's never read)
+void var_analysis::step_back(std::vector<var_use>& uses, const size_t idx)
+{
+  const auto& com = m_code[idx];
+  // Nothing before a block can use the variables in it
+  const auto forget_level = [&](const int32_t level)
+  {
+    for (size_t i{}; i != m_keys.size(); ++i) {
+      if (m_keys[i].first >= level)
+        uses[i] = {};
+    }
+  };
+
+  switch (com.instr) {
+  case vm::instruction::lread:
+    uses[m_var[idx]] = {true, true};
+    break;
+
+  case vm::instruction::lwrite:
+  case vm::instruction::llet: {
+    const auto var = m_var[idx];
+    const auto unused = com.instr == vm::instruction::llet ? !uses[var].touched
+                                                           : !uses[var].read;
+    m_dead_store[idx] = m_keys[var].first >= 0 && m_safe_store[idx] && unused;
+    uses[var] = {false, true};
+    break;
+  }
+
+  case vm::instruction::eblk:
+    forget_level(m_level[idx] + 1);
+    break;
+
+  case vm::instruction::lblk:
+    forget_level(m_level[idx]);
+    break;
+
+  default: ;
+  }
 }
 
-void vv::optimize(std::vector<vm::command>& code)
+bool remove_unreachable(std::vector<vm::command>& code, const flow_graph& graph);
+bool optimize_flow(vm::bytecode& bytecode);
+
+// Remove code that's never reached, e.g. because it's always jumped over, or
+// it's after a 'return'
+bool remove_unreachable(std::vector<vm::command>& code, const flow_graph& graph)
 {
-  while (optimize_once(code))
-    ;
+  auto changed = false;
+  for (size_t i{}; i != graph.blocks.size(); ++i) {
+    if (graph.reachable[i])
+      continue;
+    for (auto j = graph.blocks[i].first; j != graph.blocks[i].last; ++j) {
+      if (!is_noop(code[j])) {
+        changed = true;
+        code[j].instr = vm::instruction::noop;
+        code[j].arg = 0;
+      }
+    }
+  }
+  return changed;
 }
 
-void vv::optimize_independent_block(std::vector<vm::command>& code)
+// Every optimization that depends on the code's control flow
+bool optimize_flow(vm::bytecode& bytecode)
 {
+  const flow_graph graph{bytecode.commands};
+  auto changed = remove_unreachable(bytecode.commands, graph);
+
+  var_analysis vars{bytecode, graph};
+  if (vars.propagate_values())   changed = true;
+  if (vars.remove_dead_stores()) changed = true;
+  return changed;
+}
+
+// }}}
+
+// Runs every pass except optimize_flow until none of them can do anything more
+void simplify(vm::bytecode& bytecode, const bool independent)
+{
+  auto& code = bytecode.commands;
   auto changed = true;
   while (changed) {
+    peephole{bytecode}.run();
+    remove_noops(code);
+
     changed = false;
-    if (optimize_once(code))             changed = true;
-    if (optimize_independent_once(code)) changed = true;
+    if (optimize_jump_chains(code))         changed = true;
+    if (optimize_blocks(code))              changed = true;
+    if (independent && optimize_lets(code)) changed = true;
   }
 }
+
+// Building and analyzing the flow graph is far more expensive than any of the
+// other passes, so it's only done once, after they've run out of things to do;
+// they're then run again to clean up after it
+void optimize_code(vm::bytecode& bytecode, const bool independent)
+{
+  simplify(bytecode, independent);
+  if (optimize_flow(bytecode))
+    simplify(bytecode, independent);
+}
+
+}
+
+void vv::optimize(vm::bytecode& code)
+{
+  optimize_code(code, false);
+}
+
+void vv::optimize_independent_block(vm::bytecode& code)
+{
+  optimize_code(code, true);
+}
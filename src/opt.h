@@ -8,13 +8,15 @@ namespace vv {
 // Call on any chunk of valid (i.e. won't blow up the VM--- it can still result
 // in an exception being thrown or whatever) VM code to perform various
 // optimizations (e.g constant folding, eliminating unused code, etc.) without
-// changing the code's behavior.
-void optimize(std::vector<vm::command>& code);
+// changing the code's behavior. Meant to be called once, on a whole unit of
+// code (a file, function body, or line of REPL input), after it's been
+// generated; AST nodes leave their code unoptimized.
+void optimize(vm::bytecode& code);
 // Call on any complete, independent, piece of code (e.g. a function or the
 // contents of a file). Like optimize, but more agressive (e.g. eliminate unused
 // variables); calling this on a dependent line of code will probably result in
 // errors.
-void optimize_independent_block(std::vector<vm::command>& code);
+void optimize_independent_block(vm::bytecode& code);
 
 }
 
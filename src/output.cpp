@@ -0,0 +1,76 @@
+#include "output.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+using namespace vv;
+
+namespace {
+
+class buffer {
+public:
+  buffer()
+    : m_line_buffered {isatty(STDOUT_FILENO) != 0}
+  {
+    m_buf.reserve(capacity);
+  }
+
+  void write(const boost::string_ref str)
+  {
+    if (m_buf.size() + str.size() > capacity)
+      flush();
+    // Anything that wouldn't fit anyways can skip the buffer entirely
+    if (str.size() > capacity) {
+      fwrite(str.data(), 1, str.size(), stdout);
+      fflush(stdout);
+    }
+    else {
+      m_buf.append(str.data(), str.size());
+    }
+    if (m_line_buffered && str.find('\n') != boost::string_ref::npos)
+      flush();
+  }
+
+  void flush()
+  {
+    if (!m_buf.empty()) {
+      fwrite(m_buf.data(), 1, m_buf.size(), stdout);
+      m_buf.clear();
+    }
+    fflush(stdout);
+  }
+
+  ~buffer() { flush(); }
+
+private:
+  const static size_t capacity = 64 * 1024;
+
+  std::string m_buf;
+  bool m_line_buffered;
+};
+
+buffer& stdout_buffer()
+{
+  // Destroyed, and so flushed, at exit (whether from main or quit())
+  static buffer buf;
+  return buf;
+}
+
+}
+
+void output::write(const boost::string_ref str)
+{
+  stdout_buffer().write(str);
+}
+
+void output::write(const char c)
+{
+  stdout_buffer().write({&c, 1});
+}
+
+void output::flush()
+{
+  stdout_buffer().flush();
+}
@@ -0,0 +1,26 @@
+#ifndef VV_OUTPUT_H
+#define VV_OUTPUT_H
+
+#include <boost/utility/string_ref.hpp>
+
+// Buffered standard output, used by print, puts and so on. Output is written in
+// large chunks, when the buffer fills up or flush() is called; if stdout is a
+// terminal, it's also flushed at the end of every line. Anything still buffered
+// is flushed at exit.
+
+namespace vv {
+
+namespace output {
+
+void write(boost::string_ref str);
+void write(char c);
+
+// Writes out everything buffered so far. Needs to be called before writing to
+// std::cout or std::cerr directly, so as to keep output in order.
+void flush();
+
+}
+
+}
+
+#endif
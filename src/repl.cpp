@@ -2,6 +2,8 @@
 
 #include "builtins.h"
 #include "messages.h"
+#include "opt.h"
+#include "output.h"
 #include "parser.h"
 #include "gc/alloc.h"
 #include "utils/error.h"
@@ -87,14 +89,17 @@ void vv::run_repl()
     for (const auto& expr : get_valid_line()) {
       // call_frame contains a non-holding reference to code, so we need to
       // store it out here
-      const auto code = expr->code();
+      auto code = expr->code();
+      optimize(code);
       vm::call_frame frame{code};
       frame.set_env(env);
       vm::machine machine{std::move(frame)};
       try {
         machine.run();
+        output::flush();
         std::cout << "=> " << pretty_print(machine.top(), machine) << '\n';
       } catch (const vm_error& err) {
+        output::flush();
         write_error(message::caught_exception(err.error()));
       }
     }
@@ -0,0 +1,117 @@
+#include "resolver.h"
+
+#include "ast/function_definition.h"
+
+using namespace vv;
+
+ast::resolver::resolver()
+  : m_first_pass    {true},
+    m_scopes        {},
+    m_stack         {},
+    m_dynamic_scope {nullptr, true, true, {}, {}}
+{
+  m_stack.push_back(&m_dynamic_scope);
+}
+
+void ast::resolver::resolve_function(const function_definition& fn)
+{
+  resolver res;
+  fn.resolve(res);
+  res.m_first_pass = false;
+  fn.resolve(res);
+}
+
+void ast::resolver::enter_function(scope_layout& layout)
+{
+  enter(layout, true);
+}
+
+void ast::resolver::enter_block(scope_layout& layout)
+{
+  enter(layout, false);
+}
+
+void ast::resolver::enter(scope_layout& layout, bool is_function)
+{
+  auto& cur = m_scopes[&layout];
+  if (m_first_pass) {
+    cur.layout = &layout;
+    cur.is_function = is_function;
+    cur.needs_env = is_function;
+  }
+  else {
+    cur.declared.assign(cur.declared.size(), false);
+  }
+  m_stack.push_back(&cur);
+}
+
+void ast::resolver::leave()
+{
+  const auto& cur = *m_stack.back();
+  *cur.layout = { true, cur.needs_env, static_cast<int>(cur.declared.size()) };
+  m_stack.pop_back();
+}
+
+boost::optional<vm::local_variable> ast::resolver::declare(symbol name)
+{
+  auto& cur = *m_stack.back();
+  if (&cur == &m_dynamic_scope)
+    return {};
+
+  if (m_first_pass) {
+    if (!cur.names.count(name)) {
+      cur.names[name] = static_cast<int32_t>(cur.declared.size());
+      cur.declared.push_back(false);
+    }
+    cur.needs_env = true;
+    return {};
+  }
+
+  const auto slot = cur.names[name];
+  if (slot == -1)
+    return {};
+  cur.declared[static_cast<size_t>(slot)] = true;
+  return vm::local_variable{0, slot, name};
+}
+
+void ast::resolver::declare_dynamic(symbol name)
+{
+  auto& cur = *m_stack.back();
+  if (m_first_pass && &cur != &m_dynamic_scope) {
+    if (!cur.names.count(name))
+      cur.names[name] = -1;
+    cur.needs_env = true;
+  }
+}
+
+void ast::resolver::modifies_env()
+{
+  m_stack.back()->needs_env = true;
+}
+
+boost::optional<vm::local_variable> ast::resolver::lookup(symbol name)
+{
+  if (m_first_pass)
+    return {};
+
+  int32_t depth{};
+  auto crossed_function = false;
+  for (auto i = rbegin(m_stack); *i != &m_dynamic_scope; ++i) {
+    const auto& cur = **i;
+    const auto var = cur.names.find(name);
+    if (var != end(cur.names)) {
+      if (var->second == -1)
+        return {};
+      // Skip variables that haven't been declared yet, unless they're
+      // declared in an enclosing function (since then this one might not be
+      // called until after they are)
+      if (crossed_function || cur.declared[static_cast<size_t>(var->second)])
+        return vm::local_variable{depth, var->second, name};
+    }
+    if (cur.needs_env)
+      ++depth;
+    if (cur.is_function)
+      crossed_function = true;
+  }
+  return {};
+}
@@ -0,0 +1,95 @@
+#ifndef VV_RESOLVER_H
+#define VV_RESOLVER_H
+
+#include "expression.h"
+#include "vm/instruction.h"
+
+#include <boost/optional/optional.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace vv {
+
+namespace ast {
+
+// How a single scope (function body, block, etc.) is laid out at runtime, as
+// determined by the resolver.
+struct scope_layout {
+  // If false, the scope wasn't resolved, and variables declared in it are
+  // looked up by name at runtime (e.g. at the top level of a file).
+  bool resolved{false};
+  // Whether the scope gets its own environment; always true for functions, but
+  // blocks that don't declare anything don't need one.
+  bool has_env{true};
+  // Number of variable slots in the scope's environment.
+  int slots{0};
+};
+
+// Compile-time pass that assigns each local variable a slot in its scope's
+// environment, and each variable access a (depth, slot) address, so the VM
+// doesn't have to look variables up by name.
+//
+// Resolution is done one top-level function at a time (see
+// function_definition::generate); anything not declared within that function
+// (globals, variables declared at the top level of a file, and anything added
+// by 'require' or type definitions) is left to be looked up dynamically.
+//
+// Each AST node's resolve method is called twice: once to collect every scope's
+// declarations, and once to resolve variable accesses. Declarations in an
+// enclosing function are visible to nested functions regardless of where they
+// occur (so functions can be mutually recursive), but within a single function
+// a variable isn't visible until it's been declared.
+class resolver {
+public:
+  // Resolves every variable used in fn, including inside nested functions.
+  static void resolve_function(const function_definition& fn);
+
+  // Enter a new scope; when it's left, its final layout will be written to
+  // the provided scope_layout (which also identifies the scope between passes).
+  void enter_function(scope_layout& layout);
+  void enter_block(scope_layout& layout);
+  void leave();
+
+  // Declares a new variable in the current scope, returning its address (or
+  // nothing, if it's declared dynamically).
+  boost::optional<vm::local_variable> declare(symbol name);
+  // Note a variable that's going to be declared by name at runtime (e.g. by a
+  // type definition), shadowing any enclosing ones.
+  void declare_dynamic(symbol name);
+  // Note that the current scope's environment is modified at runtime (e.g. by
+  // 'require'), so it needs one even if nothing's declared in it.
+  void modifies_env();
+
+  // Returns the address of the variable name currently refers to, or nothing if
+  // it has to be looked up at runtime.
+  boost::optional<vm::local_variable> lookup(symbol name);
+
+private:
+  struct scope {
+    scope_layout* layout;
+    bool is_function;
+    bool needs_env;
+    // Slot of each variable declared in this scope; -1 if it's declared
+    // dynamically.
+    std::unordered_map<symbol, int32_t> names;
+    // Which slots have been declared so far, on the second pass.
+    std::vector<bool> declared;
+  };
+
+  resolver();
+  void enter(scope_layout& layout, bool is_function);
+
+  bool m_first_pass;
+  std::unordered_map<const scope_layout*, scope> m_scopes;
+  // Scopes enclosing the node currently being resolved; the outermost is a
+  // dummy standing in for the environment the top-level function is defined in.
+  std::vector<scope*> m_stack;
+  scope m_dynamic_scope;
+};
+
+}
+
+}
+
+#endif
@@ -1,23 +1,79 @@
 #ifndef VV_UTILS_HASH_MAP_H
 #define VV_UTILS_HASH_MAP_H
 
-#include <vector>
-#include <forward_list>
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
-#include <numeric>
+#include <new>
+#include <stdexcept>
+#include <vector>
 
 namespace vv {
 
 // Simple-minded hash map.
 // This class is a functional subset of std::unordered_map (with some methods
-// renamed), and has substantially worse performance for larger maps. However,
-// since most maps created in a running program are either empty or very small
-// (e.g. most value::base::member hashes will contain at most one or two items),
-// this class's extremely simple rehashing heuristic ends up being a net win.
+// renamed). Most maps created in a running program are either empty or very
+// small (e.g. most value::base::member hashes will contain at most one or two
+// items), so the first few elements are stored inline and searched linearly,
+// without hashing or allocating anything. Past that, elements are moved into an
+// open-addressed table (probed linearly), which doubles in size whenever it's
+// more than three quarters full.
 template <typename K, typename V>
 class hash_map {
-  struct bucket {
-    std::forward_list<std::pair<K, V>> slots;
+  // Storage for a single element, which is only constructed while it's full.
+  struct slot {
+    slot() : full {false} { }
+
+    slot(const slot& other) : full {other.full}
+    {
+      if (full)
+        new (&entry) std::pair<K, V>{other.entry};
+    }
+
+    slot(slot&& other) : full {other.full}
+    {
+      if (full)
+        new (&entry) std::pair<K, V>{std::move(other.entry)};
+    }
+
+    slot& operator=(const slot& other)
+    {
+      if (this != &other) {
+        clear();
+        if (other.full)
+          fill(K{other.entry.first}, V{other.entry.second});
+      }
+      return *this;
+    }
+
+    slot& operator=(slot&& other)
+    {
+      clear();
+      if (other.full)
+        fill(std::move(other.entry.first), std::move(other.entry.second));
+      return *this;
+    }
+
+    ~slot() { clear(); }
+
+    void fill(K&& item, V&& val)
+    {
+      new (&entry) std::pair<K, V>{std::move(item), std::move(val)};
+      full = true;
+    }
+
+    void clear()
+    {
+      if (full)
+        entry.~pair();
+      full = false;
+    }
+
+    bool full;
+    union {
+      std::pair<K, V> entry;
+    };
   };
 
 public:
@@ -26,25 +82,19 @@ public:
 
     iterator& operator++()
     {
-      ++m_minor;
-      if (m_minor == std::end(m_major->slots)) {
-        m_major = std::find_if(m_major + 1, m_end,
-                               [](const auto& i) { return !i.slots.empty(); });
-        if (m_major == m_end)
-          m_minor = {};
-        else
-          m_minor = std::begin(m_major->slots);
-      }
+      do {
+        ++m_slot;
+      } while (m_slot != m_end && !m_slot->full);
       return *this;
     }
 
-    std::pair<K, V>& operator*() const { return *m_minor; }
+    std::pair<K, V>& operator*() const { return m_slot->entry; }
 
-    std::pair<K, V>* operator->() const { return &*m_minor; }
+    std::pair<K, V>* operator->() const { return &m_slot->entry; }
 
     bool operator==(const iterator& other) const
     {
-      return m_minor == other.m_minor;
+      return m_slot == other.m_slot;
     }
 
     bool operator!=(const iterator& other) const
@@ -53,24 +103,26 @@ public:
     }
 
   private:
-    typename std::vector<bucket>::iterator m_major;
-    typename std::forward_list<std::pair<K, V>>::iterator m_minor;
-    typename std::vector<bucket>::iterator m_end;
-
-    iterator(decltype(m_major) major, decltype(m_minor) minor, decltype(m_end) end)
-      : m_major {major},
-        m_minor {minor},
-        m_end   {end}
+    slot* m_slot;
+    slot* m_end;
+
+    iterator(decltype(m_slot) slot, decltype(m_end) end)
+      : m_slot {slot},
+        m_end  {end}
     { }
     friend class hash_map;
   };
 
   // Constructs an empty hash map.
-  hash_map() : m_buckets( 0 ) { }
+  hash_map()
+    : m_size   {0},
+      m_table  {},
+      m_inline {}
+  { }
 
   // Constructs a hash map with the members of init.
   hash_map(std::initializer_list<std::pair<K, V>> init)
-    : m_buckets ( std::max(init.size() / 3, size_t{6}) )
+    : hash_map {}
   {
     for (const auto& i : init)
       insert(i.first, i.second);
@@ -78,37 +130,26 @@ public:
 
   bool empty() const
   {
-    return m_buckets.empty();
+    return m_size == 0;
   }
 
   size_t size() const
   {
-    return accumulate(std::begin(m_buckets), std::end(m_buckets), size_t{},
-                      [](auto sz, const auto& b)
-                        { return sz + distance(std::begin(b.slots), std::end(b.slots)); });
+    return m_size;
   }
 
   // Returns 1 if hash_map contains an element with key item, and 0 otherwise.
   size_t count(const K& item) const
   {
-    if (empty())
-      return 0;
-    const auto& bucket = m_buckets[s_hash(item) % m_buckets.size()];
-    return any_of(std::begin(bucket.slots), std::end(bucket.slots),
-                  [&item](const auto& i) { return i.first == item; });
+    return const_cast<hash_map*>(this)->find_slot(item) ? 1 : 0;
   }
 
   // Returns an iterator pointing to the element with key item, or end() if no
   // such element exists.
   iterator find(const K& item)
   {
-    if (empty())
-      return end();
-    const auto bucket = std::begin(m_buckets) + s_hash(item) % m_buckets.size();
-    const auto iter = std::find_if(std::begin(bucket->slots), std::end(bucket->slots),
-                                   [&item](const auto& i) { return i.first == item; });
-    return iter == std::end(bucket->slots) ? end()
-                                           : iterator{bucket, iter, std::end(m_buckets)};
+    const auto found = find_slot(item);
+    return found ? iterator{found, last_slot()} : end();
   }
 
   void insert(const K& item, const V& val)
@@ -129,43 +170,15 @@ public:
   // Inserts val at key item.
   // If an element with key item already exists, it's overwritten. This function
   // should run in O(1), but can run in O(n) if using a pathologically bad
-  // hashing algorithm or if a rehash is needed.  If an element with key item is
-  // overwritten, all iterators are preserved; otherwise, all iterators are
-  // invalidated by this method.
+  // hashing algorithm or if the table needs to grow. If an element with key
+  // item is overwritten, all iterators are preserved; otherwise, all iterators
+  // are invalidated by this method.
   void insert(K&& item, V&& val)
   {
-    // Four cases:
-    // 1. nonempty, slot already exists; need to replace value
-    // 2. nonempty, bucket isn't full; need to append to bucket
-    // 3. nonempty, bucket is full; need to rehash
-    // 4. empty; need to allocate space
-    if (!empty()) {
-      auto& bucket = m_buckets[s_hash(item) % m_buckets.size()];
-      auto sz = 1;
-      auto slot = std::begin(bucket.slots);
-      for (;slot != std::end(bucket.slots) && slot->first != item; ++slot)
-        ++sz;
-      if (slot != std::end(bucket.slots)) {
-        // Case 1
-        slot->second = std::move(val);
-      }
-      else if (sz < 6) {
-        // Case 2
-        bucket.slots.emplace_front(std::move(item), std::move(val));
-      }
-      else {
-        // Case 3
-        rehash();
-        auto& nbucket = m_buckets[s_hash(item) % m_buckets.size()];
-        nbucket.slots.emplace_front(std::move(item), std::move(val));
-      }
-    }
-    else {
-      // Case 4
-      m_buckets.resize(3);
-      auto& nbucket = m_buckets[s_hash(item) % m_buckets.size()];
-      nbucket.slots.emplace_front(std::move(item), std::move(val));
-    }
+    if (const auto found = find_slot(item))
+      found->entry.second = std::move(val);
+    else
+      add(std::move(item), std::move(val));
   }
 
   // Returns (and, if needed, constructs) the value at key `item`.
@@ -173,89 +186,125 @@ public:
   // all iterators.
   V& operator[](const K& item)
   {
-    // Four cases:
-    // 1. nonempty, slot already exists; need to return value
-    // 2. nonempty, bucket isn't full; need to append and return V{} to bucket
-    // 3. nonempty, bucket is full; need to rehash and add V{} as appropriate
-    // 4. empty; need to allocate space for V{}
-    if (!empty()) {
-      auto& bucket = m_buckets[s_hash(item) % m_buckets.size()];
-
-      auto sz = 0;
-      for (auto&& i : bucket.slots) {
-        // Case 1
-        if (i.first == item)
-          return i.second;
-        ++sz;
-      }
-      if (sz < 6) {
-        // Case 2
-        bucket.slots.emplace_front(item, V{});
-        return bucket.slots.front().second;
-      }
-      else {
-        // Case 3
-        rehash();
-        auto& nbucket = m_buckets[s_hash(item) % m_buckets.size()];
-        nbucket.slots.emplace_front(item, V{});
-        return nbucket.slots.front().second;
-      }
-    }
-    else {
-      // Case 4
-      m_buckets.resize(3);
-      auto& nbucket = m_buckets[s_hash(item) % m_buckets.size()];
-      nbucket.slots.emplace_front(item, V{});
-      return nbucket.slots.front().second;
-    }
+    if (const auto found = find_slot(item))
+      return found->entry.second;
+    return add(K{item}, V{}).entry.second;
   }
 
   // Returns the value at key item. If no item exists at key item, an
   // std::out_of_range error is thrown.
   const V& at(const K& item) const
   {
-    if (!empty()) {
-      const auto& bucket = m_buckets[s_hash(item) % m_buckets.size()];
-      const auto slot = find_if(std::begin(bucket.slots), std::end(bucket.slots),
-                                [&item](const auto& i) { return i.first == item; });
-      if (slot != std::end(bucket.slots))
-        return slot->second;
-    }
-
+    if (const auto found = const_cast<hash_map*>(this)->find_slot(item))
+      return found->entry.second;
     throw std::out_of_range{"no such item in hash_map"};
   }
 
   iterator begin()
   {
-    const auto first_nonempty = find_if(std::begin(m_buckets), std::end(m_buckets),
-                                        [](const auto& i) { return !i.slots.empty(); });
-    if (first_nonempty == std::end(m_buckets))
-      return end();
-    return {first_nonempty,
-            std::begin(first_nonempty->slots),
-            std::end(m_buckets)};
+    const auto first_full = std::find_if(first_slot(), last_slot(),
+                                         [](const auto& i) { return i.full; });
+    return {first_full, last_slot()};
   }
 
   iterator end()
   {
-    return {std::end(m_buckets), {}, std::end(m_buckets)};
+    return {last_slot(), last_slot()};
   }
 
 private:
-  std::vector<bucket> m_buckets;
+  // Number of elements stored inline before switching to a table.
+  static const size_t inline_capacity = 4;
+
+  size_t m_size;
+  // Empty until there are more than inline_capacity elements; always a power
+  // of two in size otherwise.
+  std::vector<slot> m_table;
+  // The first m_size of these are full, as long as m_table is empty.
+  std::array<slot, inline_capacity> m_inline;
+
   const static std::hash<K> s_hash;
 
-  void rehash()
+  slot* first_slot()
+  {
+    return m_table.empty() ? m_inline.data() : m_table.data();
+  }
+
+  slot* last_slot()
+  {
+    return m_table.empty() ? m_inline.data() + m_size
+                           : m_table.data() + m_table.size();
+  }
+
+  size_t index_for(const K& item) const
+  {
+    // Fibonacci hashing, since std::hash is usually the identity function (or
+    // close to it), and pointers in particular have next to no entropy in
+    // their low bits
+    const auto hash = static_cast<uint64_t>(s_hash(item)) * 0x9e3779b97f4a7c15;
+    return static_cast<size_t>(hash >> 32) & (m_table.size() - 1);
+  }
+
+  // Returns the slot containing item, or nullptr if there isn't one.
+  slot* find_slot(const K& item)
+  {
+    if (m_table.empty()) {
+      const auto last = m_inline.data() + m_size;
+      const auto found = std::find_if(m_inline.data(), last,
+                                      [&item](const auto& i) { return i.entry.first == item; });
+      return found == last ? nullptr : found;
+    }
+
+    auto& found = m_table[probe(item)];
+    return found.full ? &found : nullptr;
+  }
+
+  // Returns the index of the slot containing item, or of the empty slot it'd
+  // be put in if it isn't in the table. There's always at least one empty slot.
+  size_t probe(const K& item) const
+  {
+    auto idx = index_for(item);
+    while (m_table[idx].full && !(m_table[idx].entry.first == item))
+      idx = (idx + 1) & (m_table.size() - 1);
+    return idx;
+  }
+
+  // Adds an element with key item, which mustn't already exist.
+  slot& add(K&& item, V&& val)
   {
-    std::forward_list<std::pair<K, V>> members;
-    for (auto& i : m_buckets) {
-      members.splice_after(members.before_begin(), std::move(i.slots));
+    if (m_table.empty() && m_size < inline_capacity) {
+      auto& new_slot = m_inline[m_size++];
+      new_slot.fill(std::move(item), std::move(val));
+      return new_slot;
     }
-    m_buckets.resize(m_buckets.size() + 3);
 
-    for (auto& i : members) {
-      auto& bucket = m_buckets[s_hash(i.first) % m_buckets.size()];
-      bucket.slots.emplace_front(std::move(i));
+    if ((m_size + 1) * 4 > m_table.size() * 3)
+      grow();
+    ++m_size;
+    auto& new_slot = m_table[probe(item)];
+    new_slot.fill(std::move(item), std::move(val));
+    return new_slot;
+  }
+
+  void grow()
+  {
+    std::vector<slot> old_table(std::max(m_table.size() * 2, inline_capacity * 4));
+    swap(old_table, m_table);
+
+    const auto move_from = [this](slot& from)
+    {
+      m_table[probe(from.entry.first)].fill(std::move(from.entry.first),
+                                            std::move(from.entry.second));
+      from.clear();
+    };
+
+    if (old_table.empty()) {
+      for (auto i = m_inline.data(); i != m_inline.data() + m_size; ++i)
+        move_from(*i);
+    }
+    for (auto& i : old_table) {
+      if (i.full)
+        move_from(i);
     }
   }
 };
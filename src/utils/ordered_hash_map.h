@@ -0,0 +1,136 @@
+#ifndef VV_UTILS_ORDERED_HASH_MAP_H
+#define VV_UTILS_ORDERED_HASH_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace vv {
+
+// Hash map that iterates over its elements in the order they were inserted.
+// Like vv::hash_map, this is a functional subset of std::unordered_map. It's
+// meant for maps whose keys are expensive to hash and compare (like
+// value::dictionary's), so every element's hash is stored alongside it, and
+// keys are only ever compared if their hashes match.
+//
+// Elements are kept in a vector, in insertion order; the hash table itself is
+// just an open-addressed (linearly probed) array of indices into it, which is
+// small enough to keep at most half full.
+template <typename K, typename V,
+          typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>>
+class ordered_hash_map {
+public:
+  using iterator = typename std::vector<std::pair<K, V>>::iterator;
+  using const_iterator = typename std::vector<std::pair<K, V>>::const_iterator;
+
+  ordered_hash_map() = default;
+
+  ordered_hash_map(std::initializer_list<std::pair<K, V>> init)
+  {
+    for (const auto& i : init)
+      (*this)[i.first] = i.second;
+  }
+
+  bool empty() const { return m_items.empty(); }
+  size_t size() const { return m_items.size(); }
+
+  // Returns 1 if the map contains an element with key item, and 0 otherwise.
+  size_t count(const K& item) const
+  {
+    return find_index(item, m_hash(item)) == npos ? 0 : 1;
+  }
+
+  // Returns an iterator pointing to the element with key item, or end() if no
+  // such element exists.
+  iterator find(const K& item)
+  {
+    const auto idx = find_index(item, m_hash(item));
+    return idx == npos ? end() : begin() + static_cast<ptrdiff_t>(idx);
+  }
+
+  const_iterator find(const K& item) const
+  {
+    const auto idx = find_index(item, m_hash(item));
+    return idx == npos ? end() : begin() + static_cast<ptrdiff_t>(idx);
+  }
+
+  // Returns (and, if needed, constructs) the value at key item. Inserting a new
+  // element invalidates all iterators.
+  V& operator[](const K& item)
+  {
+    const auto hash = m_hash(item);
+    const auto idx = find_index(item, hash);
+    if (idx != npos)
+      return m_items[idx].second;
+
+    if ((m_items.size() + 1) * 2 > m_table.size())
+      grow();
+    m_table[probe_empty(hash)] = static_cast<uint32_t>(m_items.size() + 1);
+    m_hashes.push_back(hash);
+    m_items.emplace_back(item, V{});
+    return m_items.back().second;
+  }
+
+  iterator begin() { return std::begin(m_items); }
+  iterator end() { return std::end(m_items); }
+  const_iterator begin() const { return std::begin(m_items); }
+  const_iterator end() const { return std::end(m_items); }
+
+private:
+  static const size_t npos = SIZE_MAX;
+
+  // Every element, in insertion order, and its hash.
+  std::vector<std::pair<K, V>> m_items;
+  std::vector<size_t> m_hashes;
+  // One more than the index of the element in each slot, or 0 if a slot's
+  // empty. Always a power of two in size (or empty).
+  std::vector<uint32_t> m_table;
+
+  Hash m_hash;
+  KeyEqual m_equal;
+
+  size_t mask() const { return m_table.size() - 1; }
+
+  // Spreads a hash across the table, as vv::hash_map does.
+  size_t index_for(const size_t hash) const
+  {
+    return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15) >> 32)
+         & mask();
+  }
+
+  // Returns the index in m_items of the element with key item, or npos.
+  size_t find_index(const K& item, const size_t hash) const
+  {
+    if (m_table.empty())
+      return npos;
+    for (auto idx = index_for(hash); m_table[idx]; idx = (idx + 1) & mask()) {
+      const auto item_idx = m_table[idx] - 1;
+      if (m_hashes[item_idx] == hash && m_equal(m_items[item_idx].first, item))
+        return item_idx;
+    }
+    return npos;
+  }
+
+  // Returns the first empty slot in the table for the given hash.
+  size_t probe_empty(const size_t hash) const
+  {
+    auto idx = index_for(hash);
+    while (m_table[idx])
+      idx = (idx + 1) & mask();
+    return idx;
+  }
+
+  void grow()
+  {
+    m_table.assign(std::max(m_table.size() * 2, size_t{8}), 0);
+    for (size_t i = 0; i != m_items.size(); ++i)
+      m_table[probe_empty(m_hashes[i])] = static_cast<uint32_t>(i + 1);
+  }
+};
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 
 #include "builtins.h"
 #include "gc.h"
+#include "gc/block_list.h"
 #include "utils/lang.h"
 #include "utils/string_helpers.h"
 #include "value/array.h"
@@ -22,6 +23,7 @@
 #include "value/string.h"
 #include "value/string_iterator.h"
 #include "value/type.h"
+#include "vm/method_cache.h"
 
 #include <sstream>
 
@@ -30,10 +32,25 @@ using namespace value;
 
 namespace {
 
-// Global value, used to store instance variables for non-value::object classes
+// Global value, used to store instance variables for non-value::object classes.
+// Heap-allocated values are flagged in their block (see
+// gc::block_list::has_members) once they're added, so the vast majority of
+// values, which never get any members, can skip looking themselves up here
+// while being marked and swept.
 std::unordered_map<gc::managed_ptr,
                    hash_map<vv::symbol, gc::managed_ptr>> g_generic_members;
 
+// Returns obj's entry in g_generic_members, or nullptr if it doesn't have one.
+hash_map<vv::symbol, gc::managed_ptr>* generic_members_of(gc::managed_ptr obj)
+{
+  if (obj.is_immediate() ? g_generic_members.empty()
+                         : !gc::internal::g_blocks.has_members(obj)) {
+    return nullptr;
+  }
+  const auto mem = g_generic_members.find(obj);
+  return mem == end(g_generic_members) ? nullptr : &mem->second;
+}
+
 }
 
 size_t vv::size_for(const tag type)
@@ -155,6 +172,14 @@ size_t hash_val(const T& item)
   return std::hash<T>{}(item);
 }
 
+size_t string_hash(gc::managed_ptr str)
+{
+  auto& cached = static_cast<string*>(str.get())->hash;
+  if (!cached)
+    cached = hash_val(get<string>(str));
+  return cached;
+}
+
 }
 
 size_t vv::hash_for(gc::managed_ptr obj)
@@ -164,7 +189,7 @@ size_t vv::hash_for(gc::managed_ptr obj)
   case tag::character:      return hash_val(get<character>(obj));
   case tag::floating_point: return hash_val(get<floating_point>(obj));
   case tag::integer:        return hash_val(get<integer>(obj));
-  case tag::string:         return hash_val(get<string>(obj));
+  case tag::string:         return string_hash(obj);
   case tag::symbol:         return hash_val(get<value::symbol>(obj));
   default:                  return std::hash<gc::managed_ptr>{}(obj);
   }
@@ -181,10 +206,25 @@ bool val_equals(gc::managed_ptr lhs, gc::managed_ptr rhs)
   return get<T>(lhs) == get<T>(rhs);
 }
 
+bool string_equals(gc::managed_ptr lhs, gc::managed_ptr rhs)
+{
+  // Strings that have both been hashed can usually be told apart without
+  // comparing them
+  const auto lhs_hash = static_cast<string*>(lhs.get())->hash;
+  const auto rhs_hash = static_cast<string*>(rhs.get())->hash;
+  if (lhs_hash && rhs_hash && lhs_hash != rhs_hash)
+    return false;
+  return val_equals<string>(lhs, rhs);
+}
+
 }
 
 bool vv::equals(gc::managed_ptr lhs, gc::managed_ptr rhs)
 {
+  // Floats are usually stored in the pointer itself, so identical pointers can
+  // still be unequal (NaN)
+  if (lhs.tag() == tag::floating_point && rhs.tag() == tag::floating_point)
+    return val_equals<floating_point>(lhs, rhs);
   if (lhs == rhs)
     return true;
   if (lhs.tag() != rhs.tag())
@@ -195,7 +235,7 @@ bool vv::equals(gc::managed_ptr lhs, gc::managed_ptr rhs)
   case tag::character:      return val_equals<character>(lhs, rhs);
   case tag::floating_point: return val_equals<floating_point>(lhs, rhs);
   case tag::integer:        return val_equals<integer>(lhs, rhs);
-  case tag::string:         return val_equals<string>(lhs, rhs);
+  case tag::string:         return string_equals(lhs, rhs);
   case tag::symbol:         return val_equals<value::symbol>(lhs, rhs);
   default:                  return false;
   }
@@ -244,8 +284,10 @@ void vv::destroy(gc::managed_ptr obj)
 
 void vv::clear_members(gc::managed_ptr obj)
 {
-  if (obj.tag() != tag::object)
+  if (obj.tag() != tag::object && gc::internal::g_blocks.has_members(obj)) {
     g_generic_members.erase(obj);
+    gc::internal::g_blocks.set_has_members(obj, false);
+  }
 }
 
 // }}}
@@ -254,39 +296,44 @@ void vv::clear_members(gc::managed_ptr obj)
 bool vv::has_member(gc::managed_ptr object, const symbol sym)
 {
   if (object.tag() == tag::object)
-    return value::get<value::object>(object).count(sym);
-  const auto mem = g_generic_members.find(object);
-  return mem != end(g_generic_members) && mem->second.count(sym);
+    return value::get<value::object>(object).shape->slot_of(sym) != -1;
+  const auto mem = generic_members_of(object);
+  return mem && mem->count(sym);
 }
 
 gc::managed_ptr vv::get_member(gc::managed_ptr object, const symbol sym)
 {
   if (object.tag() == tag::object)
-    return value::get<value::object>(object)[sym];
-  return g_generic_members[object][sym];
+    return value::get<value::object>(object).find(sym);
+  const auto mem = generic_members_of(object);
+  if (!mem)
+    return {};
+  const auto member = mem->find(sym);
+  return member == mem->end() ? gc::managed_ptr{} : member->second;
 }
 
 void vv::set_member(gc::managed_ptr object, symbol sym, gc::managed_ptr member)
 {
   if (object.tag() == tag::object) {
-   value::get<value::object>(object)[sym] = member;
+    value::get<value::object>(object).set(sym, member);
   }
   else {
     g_generic_members[object][sym] = member;
+    if (!object.is_immediate())
+      gc::internal::g_blocks.set_has_members(object, true);
   }
+  gc::write_barrier(object);
 }
 
 void vv::mark_members(gc::managed_ptr object)
 {
   if (object.tag() == tag::object) {
-    for (auto i : value::get<value::object>(object))
-      gc::mark(i.second);
+    for (auto i : value::get<value::object>(object).slots)
+      gc::mark(i);
   }
-  else {
-    const auto mem = g_generic_members.find(object);
-    if (mem != end(g_generic_members))
-      for (auto i : mem->second)
-        gc::mark(i.second);
+  else if (const auto mem = generic_members_of(object)) {
+    for (auto i : *mem)
+      gc::mark(i.second);
   }
 }
 
@@ -302,5 +349,12 @@ gc::managed_ptr vv::get_method(gc::managed_ptr type, vv::symbol name)
   }
 }
 
+void vv::set_method(gc::managed_ptr type, vv::symbol name, gc::managed_ptr method)
+{
+  value::get<value::type>(type).methods[name] = method;
+  gc::write_barrier(type);
+  vm::method_cache::invalidate_all();
+}
+
 // }}}
 
@@ -55,6 +55,11 @@ struct result_type<boolean> {
   using type = boolean;
 };
 
+template <>
+struct result_type<floating_point> {
+  using type = double;
+};
+
 template <>
 struct result_type<character> {
   using type = character;
@@ -124,6 +129,9 @@ void clear_members(gc::managed_ptr object);
 void mark_members(gc::managed_ptr object);
 
 gc::managed_ptr get_method(gc::managed_ptr type, vv::symbol name);
+// Adds or replaces one of type's methods; always use this rather than modifying
+// its method table directly, so cached lookups are invalidated.
+void set_method(gc::managed_ptr type, vv::symbol name, gc::managed_ptr method);
 
 size_t size_for(tag type);
 
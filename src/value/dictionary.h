@@ -2,8 +2,7 @@
 #define VV_VALUE_DICTIONARY_H
 
 #include "value/basic_object.h"
-
-#include <unordered_map>
+#include "utils/ordered_hash_map.h"
 
 namespace vv {
 
@@ -11,18 +10,30 @@ namespace value {
 
 struct dictionary : public basic_object {
 public:
+  // Integers and symbols (by far the most common keys) are equal only if
+  // they're identical, so they can skip the full vv::hash_for and vv::equals.
   struct hasher {
-    size_t operator()(gc::managed_ptr obj) const { return hash_for(obj); }
+    size_t operator()(gc::managed_ptr obj) const
+    {
+      if (obj.tag() == tag::integer || obj.tag() == tag::symbol)
+        return std::hash<gc::managed_ptr>{}(obj);
+      return hash_for(obj);
+    }
   };
   struct key_equal {
     bool operator()(gc::managed_ptr lhs, gc::managed_ptr rhs) const
     {
+      if (lhs == rhs)
+        return true;
+      if (lhs.tag() == tag::integer || lhs.tag() == tag::symbol)
+        return false;
       return equals(lhs, rhs);
     }
   };
 
-  using value_type = std::unordered_map<gc::managed_ptr, gc::managed_ptr,
-                                        hasher, key_equal>;
+  // Iterates in insertion order.
+  using value_type = ordered_hash_map<gc::managed_ptr, gc::managed_ptr,
+                                      hasher, key_equal>;
 
   dictionary(const value_type& val = {});
 
@@ -2,21 +2,132 @@
 
 #include "builtins.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
 using namespace vv;
 
 value::file::file(const std::string& filename)
   : basic_object {builtin::type::file},
-    value        {filename, "", std::fstream{filename}}
-{
-  std::getline(value.val, value.cur_line);
-}
+    value        {filename}
+{ }
 
 value::file::file()
   : basic_object {builtin::type::file},
-    value        {"", "", {}}
+    value        {}
 { }
 
 value::file::file(file&& other)
   : basic_object {builtin::type::file},
     value        ( std::move(other.value) )
 { }
+
+value::file::value_type::value_type(const std::string& filename)
+  : name       {filename},
+    m_mapping  {nullptr, {0}},
+    m_size     {0},
+    m_line     {0},
+    m_line_end {0},
+    m_has_line {false},
+    m_mapped   {false}
+{
+  if (filename.empty())
+    return;
+
+  const auto fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    return;
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size) {
+      const auto data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        madvise(data, m_size, MADV_SEQUENTIAL);
+        m_mapping = {static_cast<const char*>(data), {m_size}};
+        m_mapped = true;
+      }
+    }
+    else {
+      m_mapped = true;
+    }
+  }
+  close(fd);
+
+  if (m_mapped) {
+    find_line_end();
+    return;
+  }
+  m_stream.open(filename);
+  m_has_line = static_cast<bool>(std::getline(m_stream, m_cur_line));
+}
+
+bool value::file::value_type::is_open() const
+{
+  return m_mapped || m_stream.is_open();
+}
+
+bool value::file::value_type::at_end() const
+{
+  return m_mapped ? m_line == m_size : !m_has_line;
+}
+
+boost::string_ref value::file::value_type::line() const
+{
+  if (m_mapped)
+    return {m_mapping.get() + m_line, m_line_end - m_line};
+  return m_cur_line;
+}
+
+void value::file::value_type::next()
+{
+  if (!m_mapped) {
+    m_has_line = static_cast<bool>(std::getline(m_stream, m_cur_line));
+    return;
+  }
+
+  // Skip past the current line's newline, if it has one
+  m_line = std::min(m_line_end + 1, m_size);
+  find_line_end();
+}
+
+std::string value::file::value_type::rest()
+{
+  if (m_mapped) {
+    std::string contents{m_mapping.get() + m_line, m_size - m_line};
+    m_line = m_line_end = m_size;
+    return contents;
+  }
+
+  if (!m_has_line)
+    return "";
+  std::string contents{m_cur_line};
+  if (!m_stream.eof())
+    contents += '\n';
+  contents.append(std::istreambuf_iterator<char>{m_stream}, {});
+  m_has_line = false;
+  return contents;
+}
+
+void value::file::value_type::find_line_end()
+{
+  if (m_line == m_size) {
+    m_line_end = m_size;
+    return;
+  }
+  const auto start = m_mapping.get() + m_line;
+  const auto newline = static_cast<const char*>(memchr(start, '\n', m_size - m_line));
+  m_line_end = newline ? static_cast<size_t>(newline - m_mapping.get()) : m_size;
+}
+
+void value::file::value_type::unmap::operator()(const char* data) const
+{
+  munmap(const_cast<char*>(data), size);
+}
@@ -3,7 +3,10 @@
 
 #include "value/basic_object.h"
 
+#include <boost/utility/string_ref.hpp>
+
 #include <fstream>
+#include <memory>
 
 namespace vv {
 
@@ -15,10 +18,43 @@ public:
   file();
   file(file&& other);
 
-  struct value_type {
+  // A file being read one line at a time. Regular files are mapped into
+  // memory, so lines are read straight out of the mapping; anything that can't
+  // be mapped (pipes, devices, and so on) is read through a stream instead.
+  class value_type {
+  public:
+    value_type(const std::string& filename = "");
+
+    bool is_open() const;
+    bool at_end() const;
+    // The current line, without its newline. Invalidated by next().
+    boost::string_ref line() const;
+    void next();
+    // Returns the rest of the file, starting with the current line, and moves
+    // to the end.
+    std::string rest();
+
     std::string name;
-    std::string cur_line;
-    std::fstream val;
+
+  private:
+    void find_line_end();
+
+    struct unmap {
+      size_t size;
+      void operator()(const char* data) const;
+    };
+
+    std::unique_ptr<const char, unmap> m_mapping;
+    size_t m_size;
+    // Start and end of the current line in the mapping
+    size_t m_line;
+    size_t m_line_end;
+
+    std::ifstream m_stream;
+    std::string m_cur_line;
+    bool m_has_line;
+    // Whether the file was mapped (an empty file is mapped, but has no mapping)
+    bool m_mapped;
   };
 
   value_type value;
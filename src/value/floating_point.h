@@ -3,6 +3,8 @@
 
 #include "value/basic_object.h"
 
+#include <cstring>
+
 namespace vv {
 
 namespace value {
@@ -15,6 +17,20 @@ public:
   value_type value;
 };
 
+// Floats are usually unboxed (see gc::alloc), and only occasionally stored on
+// the heap.
+template <>
+inline result_type<floating_point>::type get<floating_point>(gc::managed_ptr ptr)
+{
+  if (ptr.m_flags != gc::managed_ptr::unboxed_float)
+    return static_cast<floating_point*>(ptr.get())->value;
+
+  const auto bits = (uint64_t{ptr.m_block} << 32) | (uint64_t{ptr.m_offset} << 16);
+  double val;
+  std::memcpy(&val, &bits, sizeof(val));
+  return val;
+}
+
 }
 
 }
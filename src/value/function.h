@@ -9,16 +9,14 @@ namespace vv {
 namespace value {
 
 struct function : public basic_object {
-  function(int argc,
-           const std::vector<vm::command>& body,
-           gc::managed_ptr enclosure,
-           bool takes_varargs = false);
+  function(std::shared_ptr<const vm::function_t> prototype,
+           gc::managed_ptr enclosure);
 
   struct value_type {
-    std::vector<vm::command> body;
-    int argc;
+    // Body, argc, etc.; shared between all closures created from the same
+    // function definition.
+    std::shared_ptr<const vm::function_t> prototype;
     gc::managed_ptr enclosure;
-    bool takes_varargs;
   };
 
   value_type value;
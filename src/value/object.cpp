@@ -6,5 +6,25 @@ using namespace vv;
 
 value::object::object()
   : basic_object {builtin::type::object},
-    value        {}
+    value        {shape::empty(), {}}
 { }
+
+gc::managed_ptr value::object::members::find(const vv::symbol name) const
+{
+  const auto slot = shape->slot_of(name);
+  if (slot == -1)
+    return {};
+  return slots[static_cast<size_t>(slot)];
+}
+
+void value::object::members::set(const vv::symbol name, gc::managed_ptr member)
+{
+  const auto slot = shape->slot_of(name);
+  if (slot == -1) {
+    shape = shape->add(name);
+    slots.push_back(member);
+  }
+  else {
+    slots[static_cast<size_t>(slot)] = member;
+  }
+}
@@ -2,9 +2,11 @@
 #define VV_VALUE_OBJECT_H
 
 #include "value/basic_object.h"
+#include "value/shape.h"
 
 #include "../symbol.h"
-#include "utils/hash_map.h"
+
+#include <vector>
 
 namespace vv {
 
@@ -15,11 +17,21 @@ struct object : public basic_object {
   // Creates a new value::object of type Object
   object();
 
-  using value_type = hash_map<vv::symbol, gc::managed_ptr>;
-
   // Contains local, variable-specific members.
   // Only members of this specific object are stored here; methods are stored
-  // inside of their owning classes.
+  // inside of their owning classes. Members are stored in slots, laid out as
+  // described by the object's shape.
+  struct members {
+    // Returns the member called name, or nullptr if there isn't one.
+    gc::managed_ptr find(vv::symbol name) const;
+    // Sets the member called name, adding it if it doesn't exist yet.
+    void set(vv::symbol name, gc::managed_ptr member);
+
+    const value::shape* shape;
+    std::vector<gc::managed_ptr> slots;
+  };
+
+  using value_type = members;
   value_type value;
 };
 
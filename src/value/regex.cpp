@@ -2,14 +2,114 @@
 
 #include "builtins.h"
 
+#include <cctype>
+
 using namespace vv;
 
-value::regex::regex(const std::regex& val, const std::string& str)
+namespace {
+
+bool is_special(const char c)
+{
+  return std::string{"^$\\.*+?()[]{}|"}.find(c) != std::string::npos;
+}
+
+bool is_quantifier(const char c)
+{
+  return c == '*' || c == '+' || c == '?' || c == '{';
+}
+
+// Returns true if str contains a '|' outside of any group or character class,
+// in which case a match could start with either side of it.
+bool has_top_level_alternative(const std::string& str)
+{
+  auto depth = 0;
+  for (size_t i = 0; i < str.size(); ++i) {
+    switch (str[i]) {
+    case '\\': ++i;    break;
+    case '(':  ++depth; break;
+    case ')':  --depth; break;
+    case '|':
+      if (depth == 0)
+        return true;
+      break;
+    case '[':
+      while (++i < str.size() && str[i] != ']') {
+        if (str[i] == '\\')
+          ++i;
+      }
+      break;
+    }
+  }
+  return false;
+}
+
+// Returns the literal text at the start of str that every match has to begin
+// with, which is empty if there isn't any (or if str is too complicated to
+// tell).
+std::string literal_prefix(const std::string& str)
+{
+  if (has_top_level_alternative(str))
+    return {};
+
+  std::string prefix;
+  for (size_t i = 0; i != str.size(); ++i) {
+    auto c = str[i];
+    if (c == '\\') {
+      // Escaped punctuation is just that character; escaped letters and digits
+      // are character classes, assertions, backreferences, and so on
+      if (i + 1 == str.size() || std::isalnum(static_cast<unsigned char>(str[i + 1])))
+        break;
+      c = str[++i];
+    }
+    else if (is_special(c)) {
+      break;
+    }
+    // A quantified character might not be there at all (or might be repeated)
+    if (i + 1 != str.size() && is_quantifier(str[i + 1]))
+      break;
+    prefix += c;
+  }
+  return prefix;
+}
+
+const std::shared_ptr<const compiled_regex>& empty_regex()
+{
+  static const auto empty = std::make_shared<const compiled_regex>( "" );
+  return empty;
+}
+
+}
+
+compiled_regex::compiled_regex(const std::string& str)
+  : m_regex  {str},
+    m_prefix {literal_prefix(str)}
+{ }
+
+bool compiled_regex::search(const std::string& str, std::smatch& results) const
+{
+  if (m_prefix.empty())
+    return regex_search(str, results, m_regex);
+
+  // Only try to match where the prefix occurs, instead of at every character
+  for (auto pos = str.find(m_prefix); pos != std::string::npos;
+       pos = str.find(m_prefix, pos + 1)) {
+    auto flags = std::regex_constants::match_continuous;
+    if (pos != 0)
+      flags |= std::regex_constants::match_prev_avail;
+    if (regex_search(begin(str) + static_cast<ptrdiff_t>(pos), end(str),
+                     results, m_regex, flags)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+value::regex::regex(std::shared_ptr<const compiled_regex> val, const std::string& str)
   : basic_object {builtin::type::regex},
-    value        {val, str}
+    value        {val ? std::move(val) : empty_regex(), str}
 { }
 
 value::regex_result::regex_result(gc::managed_ptr str, std::smatch&& val)
   : basic_object     {builtin::type::regex_result},
-    value            {val, str}
+    value            {std::move(val), str}
 { }
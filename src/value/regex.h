@@ -3,17 +3,40 @@
 
 #include "value/basic_object.h"
 
+#include <memory>
 #include <regex>
 
 namespace vv {
 
+// A compiled regex, along with the literal text every match has to start with
+// (if there is any). Searching for that text is much cheaper than running the
+// regex itself, so the regex only needs to be tried where it occurs.
+class compiled_regex {
+public:
+  // Throws std::regex_error if str isn't a valid regex.
+  explicit compiled_regex(const std::string& str);
+
+  // Finds the leftmost match in str, as std::regex_search would. The search
+  // doesn't necessarily start at the beginning of str, so match positions have
+  // to be found from results[n].first, not results.position().
+  bool search(const std::string& str, std::smatch& results) const;
+
+  const std::regex& get() const { return m_regex; }
+  const std::string& prefix() const { return m_prefix; }
+
+private:
+  std::regex m_regex;
+  std::string m_prefix;
+};
+
 namespace value {
 
 struct regex : public basic_object {
-  regex(const std::regex& val = {}, const std::string& str = {});
+  regex(std::shared_ptr<const compiled_regex> val = {}, const std::string& str = {});
 
   struct value_type {
-    std::regex val;
+    // Shared between every Regex created from the same literal
+    std::shared_ptr<const compiled_regex> val;
     // Regex in string form (stored for pretty-printing)
     std::string str;
   };
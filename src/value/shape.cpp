@@ -0,0 +1,30 @@
+#include "shape.h"
+
+using namespace vv;
+
+const value::shape* value::shape::empty()
+{
+  static const shape root{};
+  return &root;
+}
+
+int value::shape::slot_of(const vv::symbol name) const
+{
+  // Objects rarely have more than a handful of members, and most lookups are
+  // cached anyways (see vm::member_cache), so a linear search is fine
+  const auto iter = find(begin(m_names), end(m_names), name);
+  if (iter == end(m_names))
+    return -1;
+  return static_cast<int>(iter - begin(m_names));
+}
+
+const value::shape* value::shape::add(const vv::symbol name) const
+{
+  auto& child = m_children[name];
+  if (!child) {
+    child.reset(new shape{});
+    child->m_names = m_names;
+    child->m_names.push_back(name);
+  }
+  return child.get();
+}
@@ -0,0 +1,47 @@
+#ifndef VV_VALUE_SHAPE_H
+#define VV_VALUE_SHAPE_H
+
+#include "symbol.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace vv {
+
+namespace value {
+
+// Layout of a value::object's members, mapping each member's name to the slot
+// it's stored in. Objects that had the same members added in the same order
+// share a shape; shapes form a tree rooted at the empty shape, and adding a
+// member moves an object to a child of its current shape. Shapes are never
+// freed, so they can be compared by address (e.g. by vm::member_cache).
+class shape {
+public:
+  // The shape of an object without any members.
+  static const shape* empty();
+
+  // Returns the slot name is stored in, or -1 if it isn't a member.
+  int slot_of(vv::symbol name) const;
+  // Returns the shape an object with this one has after adding name (which
+  // mustn't already be a member), in slot size().
+  const shape* add(vv::symbol name) const;
+
+  // Number of members, and so of slots.
+  size_t size() const { return m_names.size(); }
+  // Name of the member stored in the given slot.
+  vv::symbol name_of(size_t slot) const { return m_names[slot]; }
+
+private:
+  shape() = default;
+
+  // Every member's name, in slot order.
+  std::vector<vv::symbol> m_names;
+  mutable std::unordered_map<vv::symbol, std::unique_ptr<shape>> m_children;
+};
+
+}
+
+}
+
+#endif
@@ -2,9 +2,62 @@
 
 #include "builtins.h"
 
+#include <vector>
+
 using namespace vv;
 
 value::string::string(const std::string& val)
   : basic_object {builtin::type::string},
-    value        {val}
+    value        {val},
+    hash         {0},
+    left         {},
+    right        {},
+    length       {0}
 { }
+
+value::string::string(gc::managed_ptr left,
+                      gc::managed_ptr right,
+                      const std::string& suffix)
+  : basic_object {builtin::type::string},
+    value        {suffix},
+    hash         {0},
+    left         {left},
+    right        {right},
+    length       {size_of(*static_cast<string*>(left.get())) + suffix.size()}
+{
+  if (right)
+    length += size_of(*static_cast<string*>(right.get()));
+}
+
+void value::string::flatten()
+{
+  std::string flat;
+  flat.reserve(length);
+
+  // Ropes built up in a loop can be millions of nodes deep, so don't recurse.
+  // Each rope node is visited twice: once to queue up its children, and then
+  // again to append its suffix after them.
+  std::vector<std::pair<const string*, bool>> pending{{this, false}};
+  while (!pending.empty()) {
+    const auto str = pending.back().first;
+    const auto visited = pending.back().second;
+    pending.pop_back();
+    if (str->left && !visited) {
+      pending.emplace_back(str, true);
+      if (str->right)
+        pending.emplace_back(static_cast<const string*>(str->right.get()), false);
+      pending.emplace_back(static_cast<const string*>(str->left.get()), false);
+    }
+    else {
+      flat += str->value;
+    }
+  }
+
+  value = std::move(flat);
+  left = right = {};
+}
+
+size_t value::size_of(const string& str)
+{
+  return str.left ? str.length : str.value.size();
+}
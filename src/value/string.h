@@ -9,13 +9,48 @@ namespace vv {
 
 namespace value {
 
+// Represents a Vivaldi String.
+// Appending to a long string doesn't copy it; instead, the new string is a rope
+// node referring to it, and is only flattened into an actual std::string when
+// its contents are first needed (see get<string> below). That way, building a
+// long string up a piece at a time takes linear time overall, rather than
+// quadratic.
 struct string : public basic_object {
   string(const std::string& val = "");
+  // Constructs a rope node, whose contents are those of left, then right (if
+  // it isn't nullptr), then suffix.
+  string(gc::managed_ptr left, gc::managed_ptr right, const std::string& suffix);
+
+  // Flattens a rope node, making value its full contents.
+  void flatten();
 
   using value_type = std::string;
+  // Just the suffix until flattened, if this is a rope node.
   value_type value;
+  // Hash of value, or 0 if it hasn't been needed yet (see vv::hash_for). Has to
+  // be reset if value's ever modified.
+  size_t hash;
+
+  // Halves of a rope node, or nullptr once flattened (or if this never was
+  // one).
+  gc::managed_ptr left;
+  gc::managed_ptr right;
+  // Length of a rope node's contents.
+  size_t length;
 };
 
+// Returns the length of a String without flattening it.
+size_t size_of(const string& str);
+
+template <>
+inline result_type<string>::type get<string>(gc::managed_ptr ptr)
+{
+  auto& str = *static_cast<string*>(ptr.get());
+  if (str.left)
+    str.flatten();
+  return str.value;
+}
+
 }
 
 }
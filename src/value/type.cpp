@@ -3,6 +3,7 @@
 #include "builtins.h"
 #include "value/builtin_function.h"
 #include "value/function.h"
+#include "vm/method_cache.h"
 
 using namespace vv;
 
@@ -12,4 +13,7 @@ value::type::type(const std::function<gc::managed_ptr()>& constructor,
                   vv::symbol name)
   : basic_object      {builtin::type::custom_type},
     value             {methods, constructor, parent, name}
-{ }
+{
+  // This type might have been allocated where a cached one used to be
+  vm::method_cache::invalidate_all();
+}
@@ -4,6 +4,7 @@
 #include "gc.h"
 #include "get_file_contents.h"
 #include "messages.h"
+#include "opt.h"
 #include "builtins/array.h"
 #include "builtins/dictionary.h"
 #include "builtins/string.h"
@@ -19,6 +20,7 @@
 #include "value/floating_point.h"
 #include "value/function.h"
 #include "value/method.h"
+#include "value/object.h"
 #include "value/opt_functions.h"
 #include "value/partial_function.h"
 #include "value/range.h"
@@ -28,24 +30,39 @@
 
 using namespace vv;
 
+// Labels as values are a GCC extension (also supported by Clang); without them
+// the VM falls back to plain switch-based dispatch.
+#if defined(__GNUC__) && !defined(VV_NO_COMPUTED_GOTO)
+#define VV_COMPUTED_GOTO
+#endif
+
 vm::machine::machine(call_frame&& frame)
   : m_call_stack     {frame},
     m_transient_self {},
-    m_req_path       {""}
+    m_req_path       {""},
+    m_modules        {},
+    m_reload_modules {false},
+#ifdef VV_COMPUTED_GOTO
+    m_dispatch       {dispatch::threaded},
+#else
+    m_dispatch       {dispatch::portable},
+#endif
+    m_executed       {0}
 {
   // TODO: Merge VM and GC so they don't have to interact so weirdly
   gc::set_running_vm(*this);
 }
 
+vm::machine::~machine()
+{
+  gc::stop_running_vm(*this);
+}
+
 void vm::machine::run()
 {
-  while (frame().instr_ptr.size()) {
-    // Get next instruction (and argument, if it exists), and increment the
-    // instruction pointer
-    const auto& command = frame().instr_ptr.front();
-    frame().instr_ptr = frame().instr_ptr.subvec(1);
-    run_single_command(command);
-  }
+  // The outermost frame can't be returned from, so just run until we run out
+  // of code.
+  run_cur_scope();
 }
 
 // Run VM until it attempts (via exception or via 'ret') to pop the current
@@ -53,24 +70,30 @@ void vm::machine::run()
 void vm::machine::run_cur_scope()
 {
   const auto exit_sz = m_call_stack.size();
+  switch (m_dispatch) {
+#ifdef VV_COMPUTED_GOTO
+  case dispatch::threaded: return run_loop<dispatch::threaded>(exit_sz);
+#else
+  case dispatch::threaded:
+#endif
+  case dispatch::portable: return run_loop<dispatch::portable>(exit_sz);
+  case dispatch::counting: return run_loop<dispatch::counting>(exit_sz);
+  }
+}
 
-  while (frame().instr_ptr.size()) {
-    // Get next instruction (and argument, if it exists), and increment the
-    // instruction pointer
-    const auto& command = frame().instr_ptr.front();
-    frame().instr_ptr = frame().instr_ptr.subvec(1);
+void vm::machine::set_dispatch(const dispatch mode)
+{
+  m_dispatch = mode;
+}
 
-    if (command.instr == vm::instruction::ret && m_call_stack.size() == exit_sz) {
-      ret(command.arg.as_bool());
-      return;
-    }
-    else if (command.instr == vm::instruction::exc) {
-      except_until(exit_sz);
-    }
-    else {
-      run_single_command(command);
-    }
-  }
+size_t vm::machine::instructions_executed() const
+{
+  return m_executed;
+}
+
+void vm::machine::set_reload_modules(const bool reload)
+{
+  m_reload_modules = reload;
 }
 
 gc::managed_ptr vm::machine::top()
@@ -94,8 +117,13 @@ void vm::machine::mark()
     gc::mark(i.caller);
     for (const auto& c : i.catchers)
       gc::mark(c.second);
+    for (auto env : i.spare_envs)
+      gc::mark(env);
     i.mark_env();
   }
+
+  for (const auto& i : m_modules)
+    gc::mark(i.second.env);
 }
 
 // Instruction implementations {{{
@@ -115,12 +143,9 @@ void vm::machine::pflt(double val)
   push(gc::alloc<value::floating_point>( val ));
 }
 
-void vm::machine::pfn(const function_t& val)
+void vm::machine::pfn(const std::shared_ptr<const function_t>& val)
 {
-  push(gc::alloc<value::function>(val.argc,
-                                  val.body,
-                                  frame().env_ptr(),
-                                  val.takes_varargs));
+  push(gc::alloc<value::function>( val, frame().env_ptr() ));
 }
 
 void vm::machine::pint(value::integer val)
@@ -147,13 +172,21 @@ void vm::machine::psym(symbol val)
 void vm::machine::pre(const std::string& val)
 {
   try {
-    push(gc::alloc<value::regex>( std::regex{val}, val ));
+    push(gc::alloc<value::regex>( std::make_shared<const compiled_regex>(val), val ));
   } catch (const std::regex_error& e) {
     except(builtin::type::invalid_regex_error,
                     message::invalid_regex(e.what()));
   }
 }
 
+void vm::machine::pre(const regex_site& val)
+{
+  if (val.regex)
+    push(gc::alloc<value::regex>( val.regex, val.str ));
+  else
+    except(builtin::type::invalid_regex_error, message::invalid_regex(val.error));
+}
+
 void vm::machine::ptype(const value::integer size)
 {
   // Get type name and parent
@@ -223,12 +256,14 @@ void vm::machine::write(const symbol sym)
   const auto iter = frame().env().members.find(sym);
   if (iter != std::end(frame().env().members)) {
     iter->second = top();
+    frame().env_written();
     return;
   }
   for (auto i = frame().env().enclosing; i; i = value::get<environment>(i).enclosing) {
     const auto iter = value::get<environment>(i).members.find(sym);
     if (iter != std::end(value::get<environment>(i).members)) {
       iter->second = top();
+      gc::write_barrier(i);
       return;
     }
   }
@@ -237,10 +272,46 @@ void vm::machine::write(const symbol sym)
 
 void vm::machine::let(const symbol sym)
 {
-  if (frame().env().members.count(sym))
+  if (frame().env().members.count(sym)) {
     except(builtin::type::redeclaration_error, message::already_exists(sym));
-  else
+  }
+  else {
     frame().env().members.insert(sym, top());
+    frame().env_written();
+  }
+}
+
+void vm::machine::lread(const local_variable& var)
+{
+  const auto val = local_env(var.depth).slots[static_cast<size_t>(var.slot)];
+  if (val)
+    push(val);
+  else
+    read(var.name);
+}
+
+void vm::machine::lwrite(const local_variable& var)
+{
+  auto& slot = local_env(var.depth).slots[static_cast<size_t>(var.slot)];
+  if (slot) {
+    slot = top();
+    local_env_written(var.depth);
+  }
+  else {
+    write(var.name);
+  }
+}
+
+void vm::machine::llet(const local_variable& var)
+{
+  auto& slot = local_env(var.depth).slots[static_cast<size_t>(var.slot)];
+  if (slot) {
+    except(builtin::type::redeclaration_error, message::already_exists(var.name));
+  }
+  else {
+    slot = top();
+    local_env_written(var.depth);
+  }
 }
 
 void vm::machine::self()
@@ -268,50 +339,78 @@ void vm::machine::varg(const value::integer idx)
 
 void vm::machine::method(const symbol sym)
 {
-  m_transient_self = top();
-  m_stack.pop_back();
-  const auto method = get_method(m_transient_self.type(), sym);
+  method_cache cache;
+  method(sym, cache);
+}
+
+void vm::machine::method(const symbol sym, method_cache& cache)
+{
+  // self is left on the stack until the method's been allocated, so it can't
+  // be collected in the meantime
+  const auto self = top();
+  const auto method = cache.lookup(self.type(), sym);
   if (method) {
-    const auto fn_obj = gc::alloc<value::method>( method, m_transient_self );
-    push(fn_obj);
+    const auto fn_obj = gc::alloc<value::method>( method, self );
+    m_stack.back() = fn_obj;
   }
   else {
-    except(builtin::type::name_error,
-           message::has_no_method(m_transient_self, sym));
+    m_stack.pop_back();
+    except(builtin::type::name_error, message::has_no_method(self, sym));
   }
 }
 
 void vm::machine::readm(const symbol sym)
+{
+  member_cache cache;
+  readm(sym, cache);
+}
+
+void vm::machine::readm(const symbol sym, member_cache& cache)
 {
   const auto self = frame().env().self;
   if (!self) {
     except(builtin::type::runtime_error, message::invalid_self_access);
+    return;
   }
 
-  if (has_member(self, sym)) {
-    push(get_member(self, sym));
+  if (self.tag() == tag::object) {
+    const auto member = cache.read(value::get<value::object>(self), sym);
+    if (member) {
+      push(member);
+      return;
+    }
   }
-  else {
-    except(builtin::type::name_error, message::has_no_member(self, sym));
+  else if (has_member(self, sym)) {
+    push(get_member(self, sym));
+    return;
   }
+  except(builtin::type::name_error, message::has_no_member(self, sym));
 }
 
 void vm::machine::writem(const symbol sym)
+{
+  member_cache cache;
+  writem(sym, cache);
+}
+
+void vm::machine::writem(const symbol sym, member_cache& cache)
 {
   const auto self = frame().env().self;
-  if (self) {
-    set_member(self, sym, top());
+  if (!self) {
+    except(builtin::type::runtime_error, message::invalid_self_access);
+  }
+  else if (self.tag() == tag::object) {
+    cache.write(value::get<value::object>(self), sym, top());
+    gc::write_barrier(self);
   }
   else {
-    except(builtin::type::runtime_error, message::invalid_self_access);
+    set_member(self, sym, top());
   }
 }
 
 void vm::machine::call(const value::integer argc)
 {
-  const static std::array<vm::command, 1> body_shim{{
-    { instruction::ret, false }
-  }};
+  const static bytecode body_shim{ {instruction::ret, false} };
 
   if (top().tag() == tag::partial_function) {
     const auto func = top();
@@ -349,6 +448,7 @@ void vm::machine::call(const value::integer argc)
       frame().caller = func;
       m_stack.pop_back();
       const auto ret = value::get<value::opt_monop>(func).body(m_transient_self);
+      m_transient_self = {};
       push(ret);
 
     }
@@ -362,6 +462,7 @@ void vm::machine::call(const value::integer argc)
       m_stack.pop_back();
       const auto ret = value::get<value::opt_binop>(func).body(m_transient_self,
                                                                top());
+      m_transient_self = {};
       push(ret);
 
     }
@@ -378,32 +479,63 @@ void vm::machine::call(const value::integer argc)
                                 m_transient_self,
                                 static_cast<unsigned>(argc),
                                 m_stack.size() - 2);
+      m_transient_self = {};
       frame().caller = func;
       m_stack.pop_back();
       push(value::get<value::builtin_function>(func).body(*this));
 
     }
     else { // VV function
-      const auto takes_varargs = value::get<value::function>(func).takes_varargs;
-      const auto expected = value::get<value::function>(func).argc;
-      if (argc < expected || (!takes_varargs && expected != argc)) {
+      const auto& proto = *value::get<value::function>(func).prototype;
+      const auto expected = proto.argc;
+      if (argc < expected || (!proto.takes_varargs && expected != argc)) {
         except(builtin::type::range_error, message::wrong_argc(expected, argc));
         return;
       }
-      m_call_stack.emplace_back(value::get<value::function>(func).body,
+      m_call_stack.emplace_back(proto.body,
                                 value::get<value::function>(func).enclosure,
                                 m_transient_self,
                                 static_cast<unsigned>(argc),
                                 m_stack.size() - 2);
+      m_transient_self = {};
+      frame().env().slots.resize(static_cast<size_t>(proto.locals));
       frame().caller = func;
       m_stack.pop_back();
     }
   } catch (const vm_error& err) {
+    m_transient_self = {};
     push(err.error());
     exc();
   }
 }
 
+boost::optional<vm::call_frame> vm::machine::prepare_call(gc::managed_ptr func,
+                                                          const value::integer argc) const
+{
+  if (func.tag() != tag::function)
+    return {};
+  const auto& proto = *value::get<value::function>(func).prototype;
+  if (proto.argc != argc || proto.takes_varargs)
+    return {};
+
+  call_frame prepared{proto.body,
+                      value::get<value::function>(func).enclosure,
+                      {},
+                      static_cast<unsigned>(argc)};
+  prepared.env().slots.resize(static_cast<size_t>(proto.locals));
+  prepared.caller = func;
+  return prepared;
+}
+
+void vm::machine::call_prepared(const call_frame& prepared)
+{
+  m_call_stack.push_back(prepared);
+  // Arguments are already on the stack, just as if the function had been
+  // pushed and then popped by call
+  frame().frame_ptr = m_stack.size() - 1;
+  run_cur_scope();
+}
+
 void vm::machine::dup()
 {
   push(top());
@@ -414,14 +546,39 @@ void vm::machine::pop(const value::integer quant)
   m_stack.erase(end(m_stack) - quant, end(m_stack));
 }
 
-void vm::machine::eblk()
+void vm::machine::eblk(const value::integer slots)
 {
-  frame().set_env(gc::alloc<environment>( frame().env_ptr() ));
+  if (frame().spare_envs.empty()) {
+    frame().set_env(gc::alloc<environment>( frame().env_ptr(),
+                                            gc::managed_ptr{},
+                                            static_cast<size_t>(slots) ));
+    return;
+  }
+
+  // Reuse the environment of a block that's been left, which lblk has already
+  // cleared, instead of allocating a new one
+  const auto env = frame().spare_envs.back();
+  frame().spare_envs.pop_back();
+  auto& block = value::get<environment>(env);
+  block.enclosing = frame().env_ptr();
+  block.self = value::get<environment>(block.enclosing).self;
+  block.slots.resize(static_cast<size_t>(slots));
+  gc::write_barrier(env);
+  frame().set_env(env);
 }
 
-void vm::machine::lblk()
+void vm::machine::lblk(const bool reuse)
 {
-  frame().set_env(frame().env().enclosing);
+  const auto env = frame().env_ptr();
+  auto& block = value::get<environment>(env);
+  frame().set_env(block.enclosing);
+  if (reuse) {
+    for (auto& i : block.slots)
+      i = {};
+    if (!block.members.empty())
+      block.members = {};
+    frame().spare_envs.push_back(env);
+  }
 }
 
 void vm::machine::ret(const bool copy)
@@ -434,6 +591,7 @@ void vm::machine::ret(const bool copy)
     auto& returning_to = end(m_call_stack)[-2];
     for (const auto& i : frame().env().members)
       returning_to.env().members[i.first] = i.second;
+    returning_to.env_written();
     m_call_stack.pop_back();
   }
   else {
@@ -445,10 +603,30 @@ void vm::machine::req(const std::string& filename)
 {
   // Add extension, if it was left off
   const auto name = get_real_filename(filename, m_req_path);
+
+  // Each file is only loaded and run once; after that, requiring it just
+  // copies in the variables it defined, which also makes circular requires
+  // terminate
+  const auto canonical = canonical_filename(name, m_req_path);
+  const auto cached = m_modules.find(canonical);
+  if (cached != end(m_modules)) {
+    const auto& loaded = cached->second;
+    if (!m_reload_modules || modification_time(canonical) == loaded.modified) {
+      for (const auto& i : value::get<environment>(loaded.env).members)
+        frame().env().members[i.first] = i.second;
+      frame().env_written();
+      if (!loaded.path.empty())
+        m_req_path = loaded.path;
+      pnil();
+      return;
+    }
+  }
+
   if (is_c_exension(name)) {
     // Place in separate call frame (along with environment) so as to avoid any
     // weirdnesses with adding things to the stack or declaring new variables
-    m_call_stack.emplace_back(vector_ref<command>{},
+    const static bytecode no_code{};
+    m_call_stack.emplace_back(no_code,
                               gc::managed_ptr{},
                               gc::managed_ptr{},
                               0,
@@ -460,6 +638,8 @@ void vm::machine::req(const std::string& filename)
              "Unable to load C extension: " + *err);
       return;
     }
+    if (!canonical.empty())
+      m_modules[canonical] = {frame().env_ptr(), "", modification_time(canonical)};
     pnil();
     ret(true);
   }
@@ -472,14 +652,22 @@ void vm::machine::req(const std::string& filename)
     }
     contents.result().emplace_back(instruction::pnil);
     contents.result().emplace_back(instruction::ret, true);
-    pfn(function_t{0, contents.result()});
+    optimize(contents.result());
+    pfn(std::make_shared<const function_t>(function_t{0, std::move(contents.result())}));
     call(0);
+    // Recorded before the file's run, so that requiring it from inside itself
+    // (directly or not) sees whatever it's defined so far
+    if (!canonical.empty()) {
+      m_modules[canonical] = {frame().env_ptr(),
+                              contents.file_directory(),
+                              modification_time(canonical)};
+    }
   }
 }
 
 void vm::machine::jmp(const value::integer offset)
 {
-  frame().instr_ptr = frame().instr_ptr.shifted_by(offset);
+  frame().instr_ptr += offset;
 }
 
 void vm::machine::jf(const value::integer offset)
@@ -494,6 +682,90 @@ void vm::machine::jt(const value::integer offset)
     jmp(offset);
 }
 
+// An iteration's three stack slots are its source, a cursor, and a limit:
+// - Arrays are indexed directly: the Array, the next index, and nil.
+// - Ranges of Integers are counted through: nil, the next Integer, and the end.
+// - Anything else goes through its iterator's methods: the iterator, whether
+//   it's been started yet, and nil.
+// Neither of the first two allocates anything as it goes.
+void vm::machine::itstart()
+{
+  const auto val = top();
+  if (val.type() == builtin::type::array) {
+    pint(0);
+    pnil();
+    return;
+  }
+  if (val.type() == builtin::type::range) {
+    const auto& rng = value::get<value::range>(val);
+    if (rng.start.tag() == tag::integer && rng.end.tag() == tag::integer) {
+      const auto start = rng.start;
+      const auto end = rng.end;
+      m_stack.back() = gc::alloc<value::nil>( );
+      push(start);
+      push(end);
+      return;
+    }
+  }
+
+  opt_tmpm(builtin::sym::start);
+  call(0);
+  run_cur_scope();
+  pbool(false);
+  pnil();
+}
+
+void vm::machine::itnext(const value::integer offset)
+{
+  const auto sz = m_stack.size();
+  const auto cursor = m_stack[sz - 2];
+  if (cursor.tag() == tag::integer) {
+    const auto idx = value::get<value::integer>(cursor);
+    const auto limit = m_stack[sz - 1];
+    gc::managed_ptr item;
+    if (limit.tag() == tag::integer) {
+      if (idx >= value::get<value::integer>(limit)) {
+        jmp(offset);
+        return;
+      }
+      item = cursor;
+    }
+    else {
+      // Checked every time, since the Array might be modified along the way
+      const auto& arr = value::get<value::array>(m_stack[sz - 3]);
+      if (static_cast<size_t>(idx) >= arr.size()) {
+        jmp(offset);
+        return;
+      }
+      item = arr[static_cast<size_t>(idx)];
+    }
+    m_stack[sz - 2] = gc::alloc<value::integer>( idx + 1 );
+    push(item);
+    return;
+  }
+
+  const auto iter = m_stack[sz - 3];
+  if (truthy(cursor)) {
+    push(iter);
+    opt_incr();
+    pop(1);
+  }
+  else {
+    m_stack[sz - 2] = gc::alloc<value::boolean>( true );
+  }
+
+  push(iter);
+  opt_at_end();
+  const auto at_end = truthy(top());
+  pop(1);
+  if (at_end) {
+    jmp(offset);
+    return;
+  }
+  push(iter);
+  opt_get();
+}
+
 void vm::machine::pushc(const symbol type)
 {
   frame().catchers[type] = top();
@@ -545,11 +817,17 @@ void int_optimization(vm::machine& vm, const F& fn, const vv::symbol sym)
 }
 
 void vm::machine::opt_tmpm(const symbol sym)
+{
+  method_cache cache;
+  opt_tmpm(sym, cache);
+}
+
+void vm::machine::opt_tmpm(const symbol sym, method_cache& cache)
 {
   m_transient_self = top();
   m_stack.pop_back();
   // pointer, so get by value
-  const auto method = get_method(m_transient_self.type(), sym);
+  const auto method = cache.lookup(m_transient_self.type(), sym);
   if (method) {
     push(method);
   }
@@ -679,88 +957,261 @@ void vm::machine::opt_size()
 
 // }}}
 
-void vm::machine::run_single_command(const vm::command& command)
+// Dispatch loop {{{
+
+// Runs instructions until the code in the current frame runs out, or until the
+// frame that was on top of the call stack when run_loop was called tries to
+// return (or to except out of the current scope).
+//
+// The instruction pointer is kept in a local variable for as long as possible;
+// it's only written back to the current frame (and reread afterwards) around
+// instructions that might add or remove call frames, jump, or throw, since
+// those instructions (or the builtins they call) expect frame().instr_ptr to
+// be accurate.
+template <vm::machine::dispatch Mode>
+void vm::machine::run_loop(const size_t exit_sz)
 {
-  using boost::get;
-
-  const auto instr = command.instr;
-  const auto& arg = command.arg;
-
-  // HACK--- avoid weirdness like the following:
-  //   let i = 1
-  //   let add = i.add // self is now i
-  //   add(2)          // => 3
-  //   5 + 1           // self is now 5
-  //   add(2)          // => 7
-  if (instr != instruction::call)
-    m_transient_self = {};
-
-  switch (instr) {
-  case instruction::pbool: pbool(arg.as_bool());  break;
-  case instruction::pchar: pchar(arg.as_int());   break;
-  case instruction::pflt:  pflt(arg.as_double()); break;
-  case instruction::pfn:   pfn(arg.as_fn());      break;
-  case instruction::pint:  pint(arg.as_int());    break;
-  case instruction::pnil:  pnil();                break;
-  case instruction::pstr:  pstr(arg.as_str());    break;
-  case instruction::psym:  psym(arg.as_sym());    break;
-  case instruction::ptype: ptype(arg.as_int());   break;
-
-  case instruction::pre: pre(arg.as_str()); break;
-
-  case instruction::parr:  parr(arg.as_int());  break;
-  case instruction::pdict: pdict(arg.as_int()); break;
-
-  case instruction::read:  read(arg.as_sym());  break;
-  case instruction::write: write(arg.as_sym()); break;
-  case instruction::let:   let(arg.as_sym());   break;
-
-  case instruction::self:   self();                  break;
-  case instruction::arg:    this->arg(arg.as_int()); break;
-  case instruction::varg:   varg(arg.as_int());      break;
-  case instruction::method: method(arg.as_sym());    break;
-  case instruction::readm:  readm(arg.as_sym());     break;
-  case instruction::writem: writem(arg.as_sym());    break;
-  case instruction::call:   call(arg.as_int());      break;
-
-  case instruction::eblk: eblk();             break;
-  case instruction::lblk: lblk();             break;
-  case instruction::ret:  ret(arg.as_bool()); break;
-
-  case instruction::dup: dup();             break;
-  case instruction::pop: pop(arg.as_int()); break;
-
-  case instruction::req: req(arg.as_str()); break;
-
-  case instruction::jmp: jmp(arg.as_int()); break;
-  case instruction::jf:  jf(arg.as_int());  break;
-  case instruction::jt:  jt(arg.as_int());  break;
-
-  case instruction::pushc: pushc(arg.as_sym()); break;
-  case instruction::popc:  popc(arg.as_sym());  break;
-  case instruction::exc:   exc();               break;
-
-  case instruction::chreqp: chreqp(arg.as_str()); break;
+  auto ip = frame().instr_ptr;
+  auto end = frame().instr_end;
+  auto consts = frame().constants;
+
+#define VV_SYNCED(expr)               \
+  do {                                \
+    frame().instr_ptr = ip + 1;       \
+    expr;                             \
+    ip = frame().instr_ptr;           \
+    end = frame().instr_end;          \
+    consts = frame().constants;       \
+  } while (0)
+
+#ifdef VV_COMPUTED_GOTO
+  // Handlers for each instruction, in the order they're declared in
+  // vm::instruction.
+  static const void* const handlers[] = {
+    &&op_pbool, &&op_pchar, &&op_pflt, &&op_pfn, &&op_pint, &&op_plint,
+    &&op_pnil, &&op_pstr, &&op_psym, &&op_pre, &&op_ptype, &&op_parr,
+    &&op_pdict, &&op_read, &&op_write, &&op_let, &&op_lread, &&op_lwrite,
+    &&op_llet, &&op_self, &&op_arg, &&op_varg, &&op_method, &&op_readm,
+    &&op_writem, &&op_call, &&op_dup, &&op_pop, &&op_eblk, &&op_lblk,
+    &&op_ret, &&op_req, &&op_jmp, &&op_jf, &&op_jt, &&op_itstart,
+    &&op_itnext, &&op_pushc, &&op_popc, &&op_exc, &&op_chreqp, &&op_noop,
+    &&op_opt_tmpm, &&op_opt_add,
+    &&op_opt_sub, &&op_opt_mul, &&op_opt_div, &&op_opt_not, &&op_opt_get,
+    &&op_opt_at_end, &&op_opt_incr, &&op_opt_size
+  };
+  static_assert(sizeof(handlers) / sizeof(handlers[0]) ==
+                static_cast<size_t>(instruction::opt_size) + 1,
+                "dispatch table out of sync with vm::instruction");
+
+#define VV_NEXT()                                                        \
+  do {                                                                   \
+    if (Mode == dispatch::threaded) {                                    \
+      if (ip == end)                                                     \
+        goto done;                                                       \
+      goto *handlers[static_cast<size_t>(ip->instr)];                    \
+    }                                                                    \
+    goto next;                                                           \
+  } while (0)
+#else
+#define VV_NEXT() goto next
+#endif
+
+next:
+  if (ip == end)
+    goto done;
+  if (Mode == dispatch::counting)
+    ++m_executed;
+
+  switch (ip->instr) {
+  case instruction::pbool:      goto op_pbool;
+  case instruction::pchar:      goto op_pchar;
+  case instruction::pflt:       goto op_pflt;
+  case instruction::pfn:        goto op_pfn;
+  case instruction::pint:       goto op_pint;
+  case instruction::plint:      goto op_plint;
+  case instruction::pnil:       goto op_pnil;
+  case instruction::pstr:       goto op_pstr;
+  case instruction::psym:       goto op_psym;
+  case instruction::pre:        goto op_pre;
+  case instruction::ptype:      goto op_ptype;
+  case instruction::parr:       goto op_parr;
+  case instruction::pdict:      goto op_pdict;
+  case instruction::read:       goto op_read;
+  case instruction::write:      goto op_write;
+  case instruction::let:        goto op_let;
+  case instruction::lread:      goto op_lread;
+  case instruction::lwrite:     goto op_lwrite;
+  case instruction::llet:       goto op_llet;
+  case instruction::self:       goto op_self;
+  case instruction::arg:        goto op_arg;
+  case instruction::varg:       goto op_varg;
+  case instruction::method:     goto op_method;
+  case instruction::readm:      goto op_readm;
+  case instruction::writem:     goto op_writem;
+  case instruction::call:       goto op_call;
+  case instruction::dup:        goto op_dup;
+  case instruction::pop:        goto op_pop;
+  case instruction::eblk:       goto op_eblk;
+  case instruction::lblk:       goto op_lblk;
+  case instruction::ret:        goto op_ret;
+  case instruction::req:        goto op_req;
+  case instruction::jmp:        goto op_jmp;
+  case instruction::jf:         goto op_jf;
+  case instruction::jt:         goto op_jt;
+  case instruction::itstart:    goto op_itstart;
+  case instruction::itnext:     goto op_itnext;
+  case instruction::pushc:      goto op_pushc;
+  case instruction::popc:       goto op_popc;
+  case instruction::exc:        goto op_exc;
+  case instruction::chreqp:     goto op_chreqp;
+  case instruction::noop:       goto op_noop;
+  case instruction::opt_tmpm:   goto op_opt_tmpm;
+  case instruction::opt_add:    goto op_opt_add;
+  case instruction::opt_sub:    goto op_opt_sub;
+  case instruction::opt_mul:    goto op_opt_mul;
+  case instruction::opt_div:    goto op_opt_div;
+  case instruction::opt_not:    goto op_opt_not;
+  case instruction::opt_get:    goto op_opt_get;
+  case instruction::opt_at_end: goto op_opt_at_end;
+  case instruction::opt_incr:   goto op_opt_incr;
+  case instruction::opt_size:   goto op_opt_size;
+  }
 
-  case instruction::noop: break;
+  // Cheap instructions that only push immediate values (which gc::alloc packs
+  // into the pointer itself, without touching the heap) or shuffle the stack
+  // are handled inline, without syncing the instruction pointer. Anything that
+  // can allocate on the heap (and so start a collection), throw, or touch the
+  // call stack has to go through VV_SYNCED.
+
+op_pbool: push(gc::alloc<value::boolean>( ip->as_bool() ));                 ++ip; VV_NEXT();
+op_pchar: pchar(ip->as_int());                                              ++ip; VV_NEXT();
+op_pint:  push(gc::alloc<value::integer>( value::integer{ip->as_int()} )); ++ip; VV_NEXT();
+op_pnil:  push(gc::alloc<value::nil>( ));                                   ++ip; VV_NEXT();
+op_psym:  psym(ip->as_sym());                                               ++ip; VV_NEXT();
+op_arg:   arg(ip->as_int());                                                ++ip; VV_NEXT();
+op_dup:   push(top());                                                      ++ip; VV_NEXT();
+op_pop:   pop(ip->as_int());                                                ++ip; VV_NEXT();
+op_popc:  popc(ip->as_sym());                                               ++ip; VV_NEXT();
+op_noop:                                                                    ++ip; VV_NEXT();
+
+op_jmp: ip += 1 + ip->as_int(); VV_NEXT();
+op_jf:  ip += truthy(top()) ? 1 : 1 + ip->as_int(); VV_NEXT();
+op_jt:  ip += truthy(top()) ? 1 + ip->as_int() : 1; VV_NEXT();
+
+  // Operands for these instructions are indices into the constant pool
+op_pflt:  VV_SYNCED(pflt(consts->floats[ip->as_const()]));   VV_NEXT();
+op_pfn:   VV_SYNCED(pfn(consts->functions[ip->as_const()])); VV_NEXT();
+op_plint: VV_SYNCED(pint(consts->integers[ip->as_const()])); VV_NEXT();
+op_pstr:  VV_SYNCED(pstr(consts->strings[ip->as_const()]));  VV_NEXT();
+op_pre:   VV_SYNCED(pre(consts->regexes[ip->as_const()]));   VV_NEXT();
+
+op_ptype:  VV_SYNCED(ptype(ip->as_int()));  VV_NEXT();
+op_parr:   VV_SYNCED(parr(ip->as_int()));   VV_NEXT();
+op_pdict:  VV_SYNCED(pdict(ip->as_int()));  VV_NEXT();
+
+op_read:   VV_SYNCED(read(ip->as_sym()));   VV_NEXT();
+op_write:  VV_SYNCED(write(ip->as_sym()));  VV_NEXT();
+op_let:    VV_SYNCED(let(ip->as_sym()));    VV_NEXT();
+
+  // Local variable accesses are only synced if they have to fall back to a
+  // dynamic lookup (or throw)
+op_lread:
+  {
+    const auto& var = consts->locals[ip->as_const()];
+    const auto val = local_env(var.depth).slots[static_cast<size_t>(var.slot)];
+    if (val) {
+      push(val);
+      ++ip;
+      VV_NEXT();
+    }
+    VV_SYNCED(read(var.name));
+    VV_NEXT();
+  }
+op_lwrite:
+  {
+    const auto& var = consts->locals[ip->as_const()];
+    auto& slot = local_env(var.depth).slots[static_cast<size_t>(var.slot)];
+    if (slot) {
+      slot = top();
+      local_env_written(var.depth);
+      ++ip;
+      VV_NEXT();
+    }
+    VV_SYNCED(write(var.name));
+    VV_NEXT();
+  }
+op_llet: VV_SYNCED(llet(consts->locals[ip->as_const()])); VV_NEXT();
 
-  case instruction::opt_tmpm: opt_tmpm(arg.as_sym()); break;
+op_self:   VV_SYNCED(self());               VV_NEXT();
+op_varg:   VV_SYNCED(varg(ip->as_int()));   VV_NEXT();
+op_method:
+  {
+    const auto& site = consts->methods[ip->as_const()];
+    VV_SYNCED(method(site.name, site.cache));
+    VV_NEXT();
+  }
+op_readm:
+  {
+    const auto& site = consts->members[ip->as_const()];
+    VV_SYNCED(readm(site.name, site.cache));
+    VV_NEXT();
+  }
+op_writem:
+  {
+    const auto& site = consts->members[ip->as_const()];
+    VV_SYNCED(writem(site.name, site.cache));
+    VV_NEXT();
+  }
+op_call:   VV_SYNCED(call(ip->as_int()));   VV_NEXT();
 
-  case instruction::opt_add: opt_add(); break;
-  case instruction::opt_sub: opt_sub(); break;
-  case instruction::opt_mul: opt_mul(); break;
-  case instruction::opt_div: opt_div(); break;
+op_eblk:   VV_SYNCED(eblk(ip->as_int()));   VV_NEXT();
+op_lblk:   VV_SYNCED(lblk(ip->as_bool()));  VV_NEXT();
 
-  case instruction::opt_not: opt_not(); break;
+op_ret:
+  {
+    const auto copy = ip->as_bool();
+    if (m_call_stack.size() == exit_sz) {
+      frame().instr_ptr = ip + 1;
+      ret(copy);
+      return;
+    }
+    VV_SYNCED(ret(copy));
+    VV_NEXT();
+  }
 
-  case instruction::opt_get:    opt_get();    break;
-  case instruction::opt_at_end: opt_at_end(); break;
-  case instruction::opt_incr:   opt_incr();   break;
+op_req:    VV_SYNCED(req(consts->strings[ip->as_const()]));    VV_NEXT();
+op_itstart: VV_SYNCED(itstart());                              VV_NEXT();
+op_itnext:  VV_SYNCED(itnext(ip->as_int()));                   VV_NEXT();
+op_pushc:  VV_SYNCED(pushc(ip->as_sym()));                     VV_NEXT();
+op_exc:    VV_SYNCED(except_until(exit_sz));                   VV_NEXT();
+op_chreqp: VV_SYNCED(chreqp(consts->strings[ip->as_const()])); VV_NEXT();
 
-  case instruction::opt_size: opt_size(); break;
+op_opt_tmpm:
+  {
+    const auto& site = consts->methods[ip->as_const()];
+    VV_SYNCED(opt_tmpm(site.name, site.cache));
+    VV_NEXT();
   }
+
+op_opt_add:    VV_SYNCED(opt_add());    VV_NEXT();
+op_opt_sub:    VV_SYNCED(opt_sub());    VV_NEXT();
+op_opt_mul:    VV_SYNCED(opt_mul());    VV_NEXT();
+op_opt_div:    VV_SYNCED(opt_div());    VV_NEXT();
+op_opt_not:    VV_SYNCED(opt_not());    VV_NEXT();
+op_opt_get:    VV_SYNCED(opt_get());    VV_NEXT();
+op_opt_at_end: VV_SYNCED(opt_at_end()); VV_NEXT();
+op_opt_incr:   VV_SYNCED(opt_incr());   VV_NEXT();
+op_opt_size:   VV_SYNCED(opt_size());   VV_NEXT();
+
+done:
+  frame().instr_ptr = ip;
+
+#undef VV_NEXT
+#undef VV_SYNCED
 }
 
+// }}}
+
 namespace {
 
 std::pair<gc::managed_ptr, vv::symbol> catcher_for(const vm::call_frame& frame,
@@ -831,3 +1282,23 @@ vm::call_frame& vm::machine::frame()
 {
   return m_call_stack.back();
 }
+
+vm::environment::value_type& vm::machine::local_env(int32_t depth)
+{
+  auto env = &frame().env();
+  while (depth--)
+    env = &value::get<environment>(env->enclosing);
+  return *env;
+}
+
+void vm::machine::local_env_written(int32_t depth)
+{
+  if (!depth) {
+    frame().env_written();
+    return;
+  }
+  auto env = frame().env().enclosing;
+  while (--depth)
+    env = value::get<environment>(env).enclosing;
+  gc::write_barrier(env);
+}
@@ -3,6 +3,12 @@
 
 #include "vm/call_frame.h"
 
+#include <boost/optional.hpp>
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+
 namespace vv {
 
 namespace vm {
@@ -10,7 +16,20 @@ namespace vm {
 // Class implementing Vivaldi's virtual machine.
 class machine {
 public:
+  // Strategies run() and run_cur_scope() can use to dispatch instructions.
+  enum class dispatch {
+    // Each instruction jumps directly to the next one's handler via computed
+    // goto; only available when compiled with GCC or Clang.
+    threaded,
+    // A single switch statement shared by every instruction.
+    portable,
+    // Identical to portable, but counts every instruction executed (see
+    // instructions_executed); used for benchmarking.
+    counting
+  };
+
   machine(call_frame&& frame);
+  ~machine();
 
   machine(machine&& other) = delete;
   machine(const machine& other) = delete;
@@ -24,6 +43,16 @@ public:
   // control is returned to the calling C++ function.
   void run_cur_scope();
 
+  // Changes how instructions are dispatched; defaults to dispatch::threaded
+  // where supported, and dispatch::portable otherwise.
+  void set_dispatch(dispatch mode);
+  // Number of instructions executed so far under dispatch::counting.
+  size_t instructions_executed() const;
+
+  // Makes 'require' load files again if they've been modified since they were
+  // last loaded; by default, each file is only ever loaded once (see req).
+  void set_reload_modules(bool reload);
+
   // Returns the value on top of the stack.
   gc::managed_ptr top();
   // Pushes the provided value onto the stack.
@@ -39,13 +68,14 @@ public:
   void pbool(bool val);
   void pchar(int val);
   void pflt(double val);
-  void pfn(const function_t& val);
+  void pfn(const std::shared_ptr<const function_t>& val);
   void pint(value::integer val);
   void pnil();
   void pstr(const std::string& val);
   void psym(symbol val);
 
   void pre(const std::string& val);
+  void pre(const regex_site& val);
 
   void ptype(value::integer size);
   void parr(value::integer size);
@@ -55,19 +85,36 @@ public:
   void write(symbol sym);
   void let(symbol sym);
 
+  void lread(const local_variable& var);
+  void lwrite(const local_variable& var);
+  void llet(const local_variable& var);
+
   void self();
   void arg(value::integer idx);
   void varg(value::integer idx);
   void method(symbol sym);
+  void method(symbol sym, method_cache& cache);
   void readm(symbol sym);
+  void readm(symbol sym, member_cache& cache);
   void writem(symbol sym);
+  void writem(symbol sym, member_cache& cache);
   void call(value::integer args);
 
+  // For builtins that call the same function over and over (like map): if func
+  // is a Vivaldi function taking exactly argc arguments, returns a call frame
+  // for it that call_prepared can reuse for every call, skipping the checks
+  // call does each time. Otherwise func has to be called normally.
+  boost::optional<call_frame> prepare_call(gc::managed_ptr func,
+                                           value::integer argc) const;
+  // Equivalent to pushing the function prepared was made for, then calling
+  // call(argc) and run_cur_scope().
+  void call_prepared(const call_frame& prepared);
+
   void dup();
   void pop(value::integer num);
 
-  void eblk();
-  void lblk();
+  void eblk(value::integer slots);
+  void lblk(bool reuse);
   void ret(bool copy);
 
   void req(const std::string& file);
@@ -76,6 +123,9 @@ public:
   void jf(value::integer offset);
   void jt(value::integer offset);
 
+  void itstart();
+  void itnext(value::integer offset);
+
   void pushc(symbol type);
   void popc(symbol type);
   void exc();
@@ -87,6 +137,7 @@ public:
   // Optimization VM instructions.
 
   void opt_tmpm(symbol name);
+  void opt_tmpm(symbol name, method_cache& cache);
 
   void opt_add();
   void opt_sub();
@@ -102,12 +153,17 @@ public:
   void opt_size();
 
 private:
-  void run_single_command(const vm::command& command);
+  template <dispatch Mode>
+  void run_loop(size_t exit_sz);
 
   void except_until(size_t stack_pos);
   void except(gc::managed_ptr type, const std::string& message);
 
   call_frame& frame();
+  // The environment depth levels above the current one.
+  environment::value_type& local_env(int32_t depth);
+  // Must be called after storing anything in local_env(depth).
+  void local_env_written(int32_t depth);
 
   std::vector<call_frame> m_call_stack;
   std::vector<gc::managed_ptr> m_stack;
@@ -115,6 +171,24 @@ private:
   gc::managed_ptr m_transient_self;
 
   std::string m_req_path;
+
+  // A file that's been required.
+  struct module {
+    // The environment the file was run in, whose variables are copied into
+    // the requiring environment by every 'require' of it.
+    gc::managed_ptr env;
+    // The directory the file's in, which requiring it sets as the 'require'
+    // search path; empty for C extensions, which leave it alone.
+    std::string path;
+    // When the file was last modified, as of loading it.
+    std::time_t modified;
+  };
+  // Every file required so far, by canonical filename.
+  std::unordered_map<std::string, module> m_modules;
+  bool m_reload_modules;
+
+  dispatch m_dispatch;
+  size_t m_executed;
 };
 
 }
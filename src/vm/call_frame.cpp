@@ -6,18 +6,23 @@
 
 using namespace vv;
 
-vm::environment::environment(gc::managed_ptr enclosing, gc::managed_ptr self)
+vm::environment::environment(gc::managed_ptr enclosing,
+                             gc::managed_ptr self,
+                             size_t slots)
   : basic_object {builtin::type::object},
-    value        {enclosing, self}
+    value        {enclosing, self, slots}
 { }
 
-vm::environment::value_type::value_type(gc::managed_ptr enclosing, gc::managed_ptr self)
+vm::environment::value_type::value_type(gc::managed_ptr enclosing,
+                                        gc::managed_ptr self,
+                                        size_t slots)
   : enclosing {enclosing},
     self      {(self || !enclosing) ? self : value::get<environment>(enclosing).self},
-    members   {}
+    members   {},
+    slots     (slots)
 { }
 
-vm::call_frame::call_frame(vector_ref<vm::command> instr_ptr,
+vm::call_frame::call_frame(const vm::bytecode& code,
                            gc::managed_ptr enclosing,
                            gc::managed_ptr self,
                            size_t argc,
@@ -26,11 +31,27 @@ vm::call_frame::call_frame(vector_ref<vm::command> instr_ptr,
     frame_ptr  {frame_ptr},
     caller     {},
     catchers   {},
-    instr_ptr  {instr_ptr},
+    spare_envs {},
+    instr_ptr  {code.commands.data()},
+    instr_end  {code.commands.data() + code.size()},
+    constants  {&code.constants},
     m_env      {enclosing, self},
     m_heap_env {}
 { }
 
+vm::call_frame::call_frame()
+  : argc       {0},
+    frame_ptr  {0},
+    caller     {},
+    catchers   {},
+    spare_envs {},
+    instr_ptr  {nullptr},
+    instr_end  {nullptr},
+    constants  {nullptr},
+    m_env      {{}, {}},
+    m_heap_env {}
+{ }
+
 vm::environment::value_type& vm::call_frame::env()
 {
   return m_heap_env ? value::get<environment>(m_heap_env) : m_env;
@@ -51,10 +72,18 @@ gc::managed_ptr vm::call_frame::env_ptr()
   if (!m_heap_env) {
     m_heap_env = gc::alloc<environment>( m_env.enclosing, m_env.self );
     value::get<environment>(m_heap_env).members = std::move(m_env.members);
+    value::get<environment>(m_heap_env).slots = std::move(m_env.slots);
   }
   return m_heap_env;
 }
 
+void vm::call_frame::env_written()
+{
+  // Stack-allocated environments are marked as part of the call stack
+  if (m_heap_env)
+    gc::write_barrier(m_heap_env);
+}
+
 void vm::call_frame::mark_env()
 {
   if (m_heap_env) {
@@ -65,5 +94,7 @@ void vm::call_frame::mark_env()
     gc::mark(m_env.self);
     for (auto i : m_env.members)
       gc::mark(i.second);
+    for (auto i : m_env.slots)
+      gc::mark(i);
   }
 }
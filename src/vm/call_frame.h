@@ -6,7 +6,6 @@
 #include "symbol.h"
 #include "value/basic_object.h"
 #include "utils/hash_map.h"
-#include "utils/vector_ref.h"
 
 namespace vv {
 
@@ -24,16 +23,19 @@ namespace vm {
 // collector is significantly faster than reference counting via shared_ptr.
 struct environment : public value::basic_object {
   environment(gc::managed_ptr enclosing = {},
-              gc::managed_ptr self      = {});
+              gc::managed_ptr self      = {},
+              size_t slots              = 0);
 
   struct value_type {
-    value_type(gc::managed_ptr enclosing, gc::managed_ptr self);
+    value_type(gc::managed_ptr enclosing, gc::managed_ptr self, size_t slots = 0);
 
     // Frame in which current function (i.e. closure) was defined.
     gc::managed_ptr enclosing;
     // self, if this is a method call.
     gc::managed_ptr self;
     hash_map<symbol, gc::managed_ptr> members;
+    // Local variables, as addressed by the resolver; null until declared.
+    std::vector<gc::managed_ptr> slots;
   };
 
   value_type value;
@@ -42,11 +44,12 @@ struct environment : public value::basic_object {
 // A single call frame. The VM's call stack is implemented as a vector of these
 // in vm::machine. Each one represents a single function call.
 struct call_frame {
-  call_frame(vector_ref<vm::command> instr_ptr = {},
-             gc::managed_ptr enclosing         = {},
-             gc::managed_ptr self              = {},
-             size_t argc                       = 0,
-             size_t frame_ptr                  = 0);
+  call_frame(const vm::bytecode& code,
+             gc::managed_ptr enclosing = {},
+             gc::managed_ptr self      = {},
+             size_t argc               = 0,
+             size_t frame_ptr          = 0);
+  call_frame();
 
   // The numer of arguments the called function takes (used in stack
   // manipulation)
@@ -60,8 +63,16 @@ struct call_frame {
   // The local catch functions, if we're in a try...catch block.
   std::unordered_map<vv::symbol, gc::managed_ptr> catchers;
 
-  // Pointer to the current VM instruction we're executing.
-  vector_ref<vm::command> instr_ptr;
+  // Environments of blocks that have been left, and that nothing else refers
+  // to, waiting to be reused by the next blocks entered.
+  std::vector<gc::managed_ptr> spare_envs;
+
+  // Pointer to the next VM instruction to execute, and one past the last
+  // instruction in the current function body.
+  const vm::command* instr_ptr;
+  const vm::command* instr_end;
+  // The constant pool for the current function body.
+  const vm::constant_pool* constants;
 
   // The outermost environment. Given lexical scoping, this will of course be
   // different for each call frame.
@@ -72,6 +83,9 @@ struct call_frame {
 
   gc::managed_ptr env_ptr();
 
+  // Must be called after storing anything in env() (see gc::write_barrier).
+  void env_written();
+
   void mark_env();
 
 private:
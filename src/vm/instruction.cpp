@@ -1,113 +1,198 @@
 #include "instruction.h"
 
+#include "value/regex.h"
+
+#include <cassert>
+#include <limits>
+#include <unordered_map>
+
 using namespace vv;
 
-vm::argument::argument(const argument& other)
-  : m_val   {int64_t{}},
-    m_which {other.m_which}
-{
-  // Just assign normally, unless type has nontrivial destructor/copy ctor, in
-  // which case doing so would be ill-advised
-  switch (m_which) {
-  case arg_type::nil:                                            break;
-  case arg_type::num: m_val.num = other.m_val.num;               break;
-  case arg_type::sym: m_val.sym = other.m_val.sym;               break;
-  case arg_type::bol: m_val.bol = other.m_val.bol;               break;
-  case arg_type::str: new (&m_val) std::string{other.m_val.str}; break;
-  case arg_type::flt: m_val.flt = other.m_val.flt;               break;
-  case arg_type::fnc: new (&m_val) function_t (other.m_val.fnc); break;
-  }
-}
+namespace {
 
-vm::argument::argument(argument&& other)
-  : m_val   {int64_t{}},
-    m_which {other.m_which}
+// Symbols can't fit in a 32-bit operand, so commands instead store an index
+// into this table. Symbols are never freed, so neither is anything in here.
+std::vector<symbol> g_symbol_table;
+std::unordered_map<symbol, int32_t> g_symbol_indices;
+
+int32_t index_for(const symbol sym)
 {
-  // as per above, this time with std::move for added movement
-  switch (m_which) {
-  case arg_type::nil:                                                       break;
-  case arg_type::num: m_val.num = other.m_val.num;                          break;
-  case arg_type::sym: m_val.sym = other.m_val.sym;                          break;
-  case arg_type::bol: m_val.bol = other.m_val.bol;                          break;
-  case arg_type::str: new (&m_val) std::string{std::move(other.m_val.str)}; break;
-  case arg_type::flt: m_val.flt = other.m_val.flt;                          break;
-  case arg_type::fnc: new (&m_val) function_t (std::move(other.m_val.fnc)); break;
-  }
+  const auto iter = g_symbol_indices.find(sym);
+  if (iter != end(g_symbol_indices))
+    return iter->second;
+
+  const auto idx = static_cast<int32_t>(g_symbol_table.size());
+  g_symbol_table.push_back(sym);
+  g_symbol_indices.emplace(sym, idx);
+  return idx;
 }
 
-vm::argument& vm::argument::operator=(const argument& other)
+bool fits_in_operand(const int64_t val)
 {
-  auto tmp = other;
-  std::swap(*this, tmp);
-  return *this;
+  return val >= std::numeric_limits<int32_t>::min()
+      && val <= std::numeric_limits<int32_t>::max();
 }
 
-vm::argument& vm::argument::operator=(argument&& other)
+template <typename T>
+int32_t add_constant(std::vector<T>& pool, const T& val)
 {
-  this->~argument(); // destruct current m_val
-  m_which = other.m_which;
-  // reprise
-  switch (m_which) {
-  case arg_type::nil:                                                       break;
-  case arg_type::num: m_val.num = other.m_val.num;                          break;
-  case arg_type::sym: m_val.sym = other.m_val.sym;                          break;
-  case arg_type::bol: m_val.bol = other.m_val.bol;                          break;
-  case arg_type::str: new (&m_val) std::string{std::move(other.m_val.str)}; break;
-  case arg_type::flt: m_val.flt = other.m_val.flt;                          break;
-  case arg_type::fnc: new (&m_val) function_t (std::move(other.m_val.fnc)); break;
-  }
-  return *this;
+  pool.push_back(val);
+  return static_cast<int32_t>(pool.size() - 1);
 }
 
-vm::argument::~argument()
-{
-  using std::string;
-  switch (m_which) {
-  case arg_type::str: m_val.str.~string();     break;
-  case arg_type::fnc: m_val.fnc.~function_t(); break;
-  default: ;
-  }
 }
 
 vm::command::command(instruction new_instr, int32_t new_arg)
   : instr {new_instr},
-    arg   {int64_t{new_arg}}
+    arg   {new_arg}
 { }
 
-vm::command::command(instruction new_instr, int64_t new_arg)
+vm::command::command(instruction new_instr, bool new_arg)
   : instr {new_instr},
     arg   {new_arg}
 { }
 
 vm::command::command(instruction new_instr, symbol new_arg)
   : instr {new_instr},
-    arg   {new_arg}
+    arg   {index_for(new_arg)}
 { }
 
-vm::command::command(instruction new_instr, bool new_arg)
+vm::command::command(instruction new_instr)
   : instr {new_instr},
-    arg   {new_arg}
+    arg   {0}
 { }
 
-vm::command::command(instruction new_instr, const std::string& new_arg)
-  : instr {new_instr},
-    arg   {new_arg}
+vm::command::command()
+  : instr {instruction::pnil},
+    arg   {0}
 { }
 
-vm::command::command(instruction new_instr, double new_arg)
-  : instr {new_instr},
-    arg   {new_arg}
-{ }
+symbol vm::command::as_sym() const
+{
+  return g_symbol_table[static_cast<size_t>(arg)];
+}
 
-vm::command::command(instruction new_instr, const function_t& new_arg)
-  : instr {new_instr},
-    arg   {new_arg}
+vm::bytecode::bytecode(std::initializer_list<command> new_commands)
+  : commands  {new_commands},
+    constants {}
 { }
 
-vm::command::command(instruction new_instr)
-  : instr {new_instr} // arg is default-constructed to boost::blank
-{ }
+void vm::bytecode::emplace_back(instruction instr)
+{
+  commands.emplace_back(instr);
+}
 
-vm::command::command()
-  : instr {instruction::pnil} // arg is default-constructed to boost::blank
-{ }
+void vm::bytecode::emplace_back(instruction instr, int32_t arg)
+{
+  commands.emplace_back(instr, arg);
+}
+
+void vm::bytecode::emplace_back(instruction instr, int64_t arg)
+{
+  if (fits_in_operand(arg)) {
+    commands.emplace_back(instr, static_cast<int32_t>(arg));
+  }
+  else {
+    assert(instr == instruction::pint);
+    commands.emplace_back(instruction::plint,
+                          add_constant(constants.integers, arg));
+  }
+}
+
+void vm::bytecode::emplace_back(instruction instr, bool arg)
+{
+  commands.emplace_back(instr, arg);
+}
+
+void vm::bytecode::emplace_back(instruction instr, symbol arg)
+{
+  // Method calls and member accesses get their own call site, so they can be
+  // cached
+  if (instr == instruction::method || instr == instruction::opt_tmpm)
+    commands.emplace_back(instr, add_constant(constants.methods, {arg, {}}));
+  else if (instr == instruction::readm || instr == instruction::writem)
+    commands.emplace_back(instr, add_constant(constants.members, {arg, {}}));
+  else
+    commands.emplace_back(instr, arg);
+}
+
+void vm::bytecode::emplace_back(instruction instr, const std::string& arg)
+{
+  if (instr != instruction::pre) {
+    commands.emplace_back(instr, add_constant(constants.strings, arg));
+    return;
+  }
+
+  regex_site site{arg, {}, {}};
+  try {
+    site.regex = std::make_shared<const compiled_regex>( arg );
+  } catch (const std::regex_error& e) {
+    site.error = e.what();
+  }
+  commands.emplace_back(instr, add_constant(constants.regexes, site));
+}
+
+void vm::bytecode::emplace_back(instruction instr, double arg)
+{
+  commands.emplace_back(instr, add_constant(constants.floats, arg));
+}
+
+void vm::bytecode::emplace_back(instruction instr, function_t arg)
+{
+  const auto proto = std::make_shared<const function_t>(std::move(arg));
+  commands.emplace_back(instr, add_constant(constants.functions, proto));
+}
+
+void vm::bytecode::emplace_back(instruction instr, const local_variable& arg)
+{
+  commands.emplace_back(instr, add_constant(constants.locals, arg));
+}
+
+void vm::bytecode::push_back(command com)
+{
+  commands.push_back(com);
+}
+
+void vm::bytecode::append(const bytecode& other)
+{
+  const auto floats    = static_cast<int32_t>(constants.floats.size());
+  const auto integers  = static_cast<int32_t>(constants.integers.size());
+  const auto strings   = static_cast<int32_t>(constants.strings.size());
+  const auto functions = static_cast<int32_t>(constants.functions.size());
+  const auto locals    = static_cast<int32_t>(constants.locals.size());
+  const auto methods   = static_cast<int32_t>(constants.methods.size());
+  const auto members   = static_cast<int32_t>(constants.members.size());
+  const auto regexes   = static_cast<int32_t>(constants.regexes.size());
+
+  auto& pool = other.constants;
+  copy(begin(pool.floats), end(pool.floats), back_inserter(constants.floats));
+  copy(begin(pool.integers), end(pool.integers), back_inserter(constants.integers));
+  copy(begin(pool.strings), end(pool.strings), back_inserter(constants.strings));
+  copy(begin(pool.functions), end(pool.functions), back_inserter(constants.functions));
+  copy(begin(pool.locals), end(pool.locals), back_inserter(constants.locals));
+  copy(begin(pool.methods), end(pool.methods), back_inserter(constants.methods));
+  copy(begin(pool.members), end(pool.members), back_inserter(constants.members));
+  copy(begin(pool.regexes), end(pool.regexes), back_inserter(constants.regexes));
+
+  commands.reserve(commands.size() + other.size());
+  for (auto com : other.commands) {
+    switch (com.instr) {
+    case instruction::pflt:     com.arg += floats;    break;
+    case instruction::plint:    com.arg += integers;  break;
+    case instruction::pstr:
+    case instruction::req:
+    case instruction::chreqp:   com.arg += strings;   break;
+    case instruction::pfn:      com.arg += functions; break;
+    case instruction::lread:
+    case instruction::lwrite:
+    case instruction::llet:     com.arg += locals;    break;
+    case instruction::method:
+    case instruction::opt_tmpm: com.arg += methods;   break;
+    case instruction::readm:
+    case instruction::writem:   com.arg += members;   break;
+    case instruction::pre:      com.arg += regexes;   break;
+    default: ;
+    }
+    commands.push_back(com);
+  }
+}
@@ -2,25 +2,55 @@
 #define VV_VM_INSTRUCTIONS_H
 
 #include "symbol.h"
+#include "vm/member_cache.h"
+#include "vm/method_cache.h"
 
-#include <unordered_map>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace vv {
 
+class compiled_regex;
+
 namespace vm {
 
-struct command;
+struct function_t;
+
+// Address of a local variable, as determined at compile time: the number of
+// environments to go up from the current one, and the variable's slot in that
+// environment. The name's kept around for error messages, and as a fallback in
+// case the variable hasn't been initialized yet (in which case it's looked up
+// by name, as with 'read' and 'write').
+struct local_variable {
+  int32_t depth;
+  int32_t slot;
+  symbol name;
+};
 
-// Simple struct for passing around Vivaldi functions.
-struct function_t {
-  int argc;
-  std::vector<command> body;
-  bool takes_varargs{false};
+// A call site's method name, and the cache for looking it up.
+struct method_site {
+  symbol name;
+  mutable method_cache cache;
+};
+
+// A member access's name, and the cache for looking it up.
+struct member_site {
+  symbol name;
+  mutable member_cache cache;
+};
+
+// A regex literal, compiled once, when its bytecode is generated. If it isn't a
+// valid regex, the error's kept instead, to be thrown if the literal's ever
+// actually evaluated.
+struct regex_site {
+  std::string str;
+  std::shared_ptr<const compiled_regex> regex;
+  std::string error;
 };
 
 // Individual Vivaldi VM opcodes.
-enum class instruction {
+enum class instruction : uint8_t {
   // pushes the provided Bool literal onto the stack.
   pbool,
   // pushes the provided Char literal onto the stack.
@@ -31,6 +61,9 @@ enum class instruction {
   pfn,
   // pushes the provided Integer literal onto the stack.
   pint,
+  // pushes the provided Integer literal, which is too large to fit in an
+  // operand and so is stored in the constant pool, onto the stack.
+  plint,
   // pushes a Nil literal onto the stack.
   pnil,
   // pushes the provided String literal onto the stack.
@@ -54,6 +87,13 @@ enum class instruction {
   write,
   // creates a new variable with the value on top of the stack.
   let,
+  // reads the local variable at the provided address onto the stack.
+  lread,
+  // writes the top value to the local variable at the provided address.
+  lwrite,
+  // initializes the local variable at the provided address with the value on
+  // top of the stack.
+  llet,
 
   // reads self onto the stack.
   self,
@@ -76,9 +116,10 @@ enum class instruction {
   // removes the provided number of objects from the top of the stack.
   pop,
 
-  // enters a new block.
+  // enters a new block, with the provided number of local variable slots.
   eblk,
-  // leaves current block.
+  // leaves current block; if provided argument is true, nothing can still refer
+  // to the block's environment, so it's kept for the next block entered to reuse.
   lblk,
   // returns from a function; if provided argument is true, copy members of
   // local frame to parent.
@@ -93,6 +134,12 @@ enum class instruction {
   jf,
   // jump the provided number of commands if the top value is truthy.
   jt,
+  // replaces the top value with the state of an iteration over it, which takes
+  // up three stack slots.
+  itstart,
+  // jumps the provided number of commands if the iteration on top of the stack
+  // is finished, and otherwise pushes its next item and advances it.
+  itnext,
   // pushes top value as a new function for catching exceptions; type-matching
   // is done by comparing the exception's type's name to the symbol argument
   // provided to pushc.
@@ -137,88 +184,94 @@ enum class instruction {
 };
 
 
-// Represents an argument in a VM command. Each VM command consists of an
-// instruction and, optionally, an argument (either an int, a symbol, a bool,
-// an std::string, a double, a function_t, or a type_t); all these possible
-// values are represented by this class.
-// As a side note, each type in this union is repeated in *quintuplicate*:
-// - ctor
-// - getter
-// - union member
-// - union ctor
-// - enum
-// This is somewhat displeasing, but boost::variant seems to be a slight
-// bottleneck, so here we are.
-class argument {
-public:
-  argument()                       : m_val{false}, m_which{arg_type::nil} { }
-  argument(int64_t num)            : m_val{num},   m_which{arg_type::num} { }
-  argument(symbol sym)             : m_val{sym},   m_which{arg_type::sym} { }
-  argument(bool bol)               : m_val{bol},   m_which{arg_type::bol} { }
-  argument(const std::string& str) : m_val{str},   m_which{arg_type::str} { }
-  argument(double flt)             : m_val{flt},   m_which{arg_type::flt} { }
-  argument(const function_t& fnc)  : m_val{fnc},   m_which{arg_type::fnc} { }
-
-  argument(const argument& other);
-  argument(argument&& other);
-
-  argument& operator=(const argument& other);
-  argument& operator=(argument&& other);
-
-  int64_t            as_int()    const { return m_val.num; }
-  symbol             as_sym()    const { return m_val.sym; }
-  bool               as_bool()   const { return m_val.bol; }
-  const std::string& as_str()    const { return m_val.str; }
-  double             as_double() const { return m_val.flt; }
-  const function_t&  as_fn()     const { return m_val.fnc; }
-
-  ~argument();
-
-private:
-  union arg_val {
-    int64_t     num;
-    symbol      sym;
-    bool        bol;
-    std::string str;
-    double      flt;
-    function_t  fnc;
-
-    arg_val(int64_t num)            : num{num} { }
-    arg_val(symbol sym)             : sym{sym} { }
-    arg_val(bool bol)               : bol{bol} { }
-    arg_val(const std::string& str) : str{str} { }
-    arg_val(double flt)             : flt{flt} { }
-    arg_val(const function_t& fnc)  : fnc(fnc) { }
-
-    ~arg_val() { }
-  } m_val;
-
-  enum class arg_type {
-    nil,
-    num,
-    sym,
-    bol,
-    str,
-    flt,
-    fnc,
-  } m_which;
-};
-
-// Represents a VM command (instruction + optional arg).
+// Represents a VM command: an instruction and its (optional) 32-bit operand.
+// Depending on the instruction, the operand is either an immediate value (an
+// Integer, Bool, or Char literal, an argument count, a jump offset, etc.), a
+// symbol (encoded as an index into a global symbol table), or an index into
+// the constant pool of the function the command belongs to.
 struct command {
 public:
   command(instruction instr, int32_t arg);
-  command(instruction instr, int64_t arg);
-  command(instruction instr, symbol arg);
   command(instruction instr, bool arg);
-  command(instruction instr, const std::string& arg);
-  command(instruction instr, double arg);
-  command(instruction instr, const function_t& arg);
+  command(instruction instr, symbol arg);
   command(instruction instr);
   command();
 
+  int32_t as_int()   const { return arg; }
+  bool    as_bool()  const { return arg != 0; }
+  symbol  as_sym()   const;
+  // Operand as an index into the constant pool.
+  size_t  as_const() const { return static_cast<size_t>(arg); }
+
   instruction instr;
-  argument arg;
+  int32_t arg;
+};
+
+static_assert(sizeof(command) == 8, "VM commands should be 8 bytes wide");
+
+// Literals too large to fit in a command's operand, referred to by index. Each
+// instruction only ever refers to one pool:
+// - pflt: floats
+// - plint: integers
+// - pstr, req, chreqp: strings
+// - pre: regexes
+// - pfn: functions
+// - lread, lwrite, llet: locals
+// - method, opt_tmpm: methods
+// - readm, writem: members
+// Function prototypes are immutable and shared, both between copies of the
+// pool and with every value::function created from them.
+struct constant_pool {
+  std::vector<double> floats;
+  std::vector<int64_t> integers;
+  std::vector<std::string> strings;
+  std::vector<std::shared_ptr<const function_t>> functions;
+  std::vector<local_variable> locals;
+  std::vector<method_site> methods;
+  std::vector<member_site> members;
+  std::vector<regex_site> regexes;
+};
+
+// A sequence of VM commands, along with the constants they refer to. Appending
+// one block of bytecode to another merges their constant pools, adjusting the
+// appended commands' operands to match.
+class bytecode {
+public:
+  bytecode() = default;
+  bytecode(std::initializer_list<command> commands);
+
+  void emplace_back(instruction instr);
+  void emplace_back(instruction instr, int32_t arg);
+  void emplace_back(instruction instr, int64_t arg);
+  void emplace_back(instruction instr, bool arg);
+  void emplace_back(instruction instr, symbol arg);
+  void emplace_back(instruction instr, const std::string& arg);
+  void emplace_back(instruction instr, double arg);
+  void emplace_back(instruction instr, function_t arg);
+  void emplace_back(instruction instr, const local_variable& arg);
+
+  void push_back(command com);
+  void append(const bytecode& other);
+
+  size_t size() const { return commands.size(); }
+  command& operator[](size_t idx) { return commands[idx]; }
+  const command& operator[](size_t idx) const { return commands[idx]; }
+
+  std::vector<command> commands;
+  constant_pool constants;
+};
+
+// Simple struct for passing around Vivaldi functions.
+struct function_t {
+  int argc;
+  bytecode body;
+  // In principle this is redundant, since we could examine the body to figure
+  // out if it contains a varg instruction, but that could be dangerous in case
+  // the varg is optimized out--- we still want to accept functions with more
+  // than `argc` arguments!
+  bool takes_varargs{false};
+  // Number of local variable slots in the function's environment.
+  int locals{0};
 };
 
 }
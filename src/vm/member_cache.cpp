@@ -0,0 +1,51 @@
+#include "member_cache.h"
+
+using namespace vv;
+
+vm::member_cache::member_cache()
+  : m_shape {nullptr},
+    m_next  {nullptr},
+    m_slot  {0}
+{ }
+
+gc::managed_ptr vm::member_cache::read(const value::object::members& obj,
+                                       const symbol name)
+{
+  // m_next always has the member in m_slot, whether it was cached by a read
+  // or a write
+  if (obj.shape != m_next) {
+    const auto slot = obj.shape->slot_of(name);
+    // Don't cache failed lookups, since they're about to throw anyways
+    if (slot == -1)
+      return {};
+    m_shape = m_next = obj.shape;
+    m_slot = static_cast<size_t>(slot);
+  }
+  return obj.slots[m_slot];
+}
+
+void vm::member_cache::write(value::object::members& obj,
+                             const symbol name,
+                             const gc::managed_ptr member)
+{
+  if (obj.shape != m_shape) {
+    const auto slot = obj.shape->slot_of(name);
+    m_shape = obj.shape;
+    if (slot == -1) {
+      m_next = obj.shape->add(name);
+      m_slot = obj.slots.size();
+    }
+    else {
+      m_next = obj.shape;
+      m_slot = static_cast<size_t>(slot);
+    }
+  }
+
+  if (m_next != m_shape) {
+    obj.shape = m_next;
+    obj.slots.push_back(member);
+  }
+  else {
+    obj.slots[m_slot] = member;
+  }
+}
@@ -0,0 +1,38 @@
+#ifndef VV_VM_MEMBER_CACHE_H
+#define VV_VM_MEMBER_CACHE_H
+
+#include "symbol.h"
+#include "value/object.h"
+
+namespace vv {
+
+namespace vm {
+
+// Inline cache for the member accesses done at a single site ('readm' and
+// 'writem' instructions). Remembers which slot the member was in for the last
+// shape of object it was accessed on, and, if writing to it added it, the shape
+// the object ended up with; objects with that same shape can then skip looking
+// the member up entirely. Shapes are never freed, so the cache never needs to be
+// invalidated.
+class member_cache {
+public:
+  member_cache();
+
+  // Returns obj's member name, or nullptr if there isn't one, exactly as
+  // value::object::members::find would.
+  gc::managed_ptr read(const value::object::members& obj, symbol name);
+  // Sets obj's member name, exactly as value::object::members::set would.
+  void write(value::object::members& obj, symbol name, gc::managed_ptr member);
+
+private:
+  const value::shape* m_shape;
+  // Shape after writing the member; the same as m_shape unless writing added it.
+  const value::shape* m_next;
+  size_t m_slot;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include "method_cache.h"
+
+#include "value.h"
+
+using namespace vv;
+
+namespace {
+
+uint32_t g_epoch{1};
+size_t g_hits{};
+size_t g_misses{};
+
+}
+
+const size_t vm::method_cache::max_types;
+
+vm::method_cache::method_cache()
+  : m_entries {},
+    m_size    {0},
+    m_epoch   {0}
+{ }
+
+gc::managed_ptr vm::method_cache::lookup(gc::managed_ptr type, symbol name)
+{
+  if (m_epoch != g_epoch) {
+    m_size = 0;
+    m_epoch = g_epoch;
+  }
+
+  const auto cached = std::min<size_t>(m_size, max_types);
+  for (size_t i{}; i != cached; ++i) {
+    if (m_entries[i].type == type) {
+      ++g_hits;
+      return m_entries[i].method;
+    }
+  }
+
+  ++g_misses;
+  const auto method = get_method(type, name);
+  // Don't cache failed lookups, since they're about to throw anyways
+  if (method && m_size <= max_types) {
+    if (m_size != max_types)
+      m_entries[m_size] = { type, method };
+    ++m_size;
+  }
+  return method;
+}
+
+size_t vm::method_cache::size() const
+{
+  return m_epoch == g_epoch ? m_size : 0;
+}
+
+void vm::method_cache::invalidate_all()
+{
+  ++g_epoch;
+}
+
+size_t vm::method_cache::hits()
+{
+  return g_hits;
+}
+
+size_t vm::method_cache::misses()
+{
+  return g_misses;
+}
@@ -0,0 +1,58 @@
+#ifndef VV_VM_METHOD_CACHE_H
+#define VV_VM_METHOD_CACHE_H
+
+#include "symbol.h"
+#include "gc/managed_ptr.h"
+
+#include <array>
+
+namespace vv {
+
+namespace vm {
+
+// Inline cache for the method lookups done at a single call site ('method' and
+// 'opt_tmpm' instructions, and builtins that call methods on their arguments).
+// Remembers the method found for the last type it was looked up on
+// (monomorphic), or for up to four different types (polymorphic); past that the
+// site's megamorphic, and every lookup goes through get_method.
+//
+// Every cache is invalidated whenever any type is created or has its method
+// table changed (see invalidate_all); that's rare enough that per-type versions
+// aren't worth tracking.
+class method_cache {
+public:
+  static const size_t max_types = 4;
+
+  method_cache();
+
+  // Looks up method name on type, exactly as get_method would.
+  gc::managed_ptr lookup(gc::managed_ptr type, symbol name);
+
+  // Number of types currently cached; max_types + 1 if megamorphic.
+  size_t size() const;
+
+  // Must be called whenever a type's method table changes, or a new type's
+  // created (since it could have been allocated over a cached one).
+  static void invalidate_all();
+
+  // Lookups served from a cache, and lookups that had to search a type (for
+  // profiling).
+  static size_t hits();
+  static size_t misses();
+
+private:
+  struct entry {
+    gc::managed_ptr type;
+    gc::managed_ptr method;
+  };
+
+  std::array<entry, max_types> m_entries;
+  uint32_t m_size;
+  uint32_t m_epoch;
+};
+
+}
+
+}
+
+#endif
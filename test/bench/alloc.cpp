@@ -0,0 +1,80 @@
+// Measures allocation and reclamation throughput of gc::block_list, using the
+// sizes of the objects Vivaldi actually allocates. Objects are freed in a
+// scattered order, as they would be by a sweep after most of them died, so the
+// free space left behind is fragmented.
+//
+// Usage: bench_alloc [repetitions]
+
+#include "value.h"
+#include "gc/block_list.h"
+#include "gc/managed_ptr.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace vv;
+
+namespace {
+
+// Roughly the mix of objects allocated by a typical script.
+const std::vector<tag> allocated_tags{
+  tag::string, tag::string, tag::string, tag::floating_point,
+  tag::floating_point, tag::array, tag::array_iterator, tag::range,
+  tag::environment, tag::environment, tag::function, tag::method,
+  tag::object, tag::dictionary, tag::string_iterator, tag::partial_function
+};
+
+}
+
+int main(int argc, char** argv)
+{
+  const auto repetitions = argc > 1 ? std::stoi(argv[1]) : 20;
+  const size_t live_objects = 200'000;
+
+  gc::block_list blocks;
+  std::minstd_rand rng{42};
+  std::vector<std::pair<gc::managed_ptr, size_t>> allocated;
+  allocated.reserve(live_objects);
+
+  size_t allocations = 0;
+  size_t reclamations = 0;
+  double alloc_seconds = 0;
+  double reclaim_seconds = 0;
+
+  for (auto rep = repetitions; rep--;) {
+    auto start = std::chrono::steady_clock::now();
+    while (allocated.size() != live_objects) {
+      const auto sz = size_for(allocated_tags[rng() % allocated_tags.size()]);
+      auto ptr = blocks.allocate(sz);
+      if (!ptr) {
+        blocks.expand();
+        ptr = blocks.allocate(sz);
+      }
+      allocated.emplace_back(ptr, sz);
+      ++allocations;
+    }
+    auto finish = std::chrono::steady_clock::now();
+    alloc_seconds += std::chrono::duration<double>(finish - start).count();
+
+    // Free about 90% of everything, in a random order
+    std::shuffle(begin(allocated), end(allocated), rng);
+    const auto survivors = allocated.size() / 10;
+    start = std::chrono::steady_clock::now();
+    for (auto i = allocated.size(); i-- != survivors;) {
+      blocks.reclaim(allocated[i].first, allocated[i].second);
+      ++reclamations;
+    }
+    finish = std::chrono::steady_clock::now();
+    reclaim_seconds += std::chrono::duration<double>(finish - start).count();
+    allocated.resize(survivors);
+  }
+
+  std::cout << "allocate: " << allocations << " in " << alloc_seconds * 1e3
+            << " ms, " << alloc_seconds * 1e9 / static_cast<double>(allocations)
+            << " ns/allocation\n"
+            << "reclaim:  " << reclamations << " in " << reclaim_seconds * 1e3
+            << " ms, "
+            << reclaim_seconds * 1e9 / static_cast<double>(reclamations)
+            << " ns/reclamation\n";
+}
@@ -0,0 +1,108 @@
+// Measures how long it takes to load a large, deeply nested script: tokenizing,
+// parsing, generating and optimizing its code, and running it (which does
+// nothing but define its functions) are each timed separately. The script's
+// generated on the fly, as a series of functions whose bodies are nested
+// blocks, loops, and conditionals.
+//
+// Usage: bench_compile [functions] [nesting depth] [file to write script to]
+
+#include "builtins.h"
+#include "opt.h"
+#include "parser.h"
+#include "vm.h"
+#include "gc/alloc.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace vv;
+
+namespace {
+
+void write_body(std::ostream& out, const int level, const int depth)
+{
+  if (level == depth) {
+    out << "x * 2 + 1";
+    return;
+  }
+
+  const auto var = "v" + std::to_string(level);
+  out << "do\n"
+      << "  let " << var << " = x + " << level << " * 2\n"
+      << "  while " << var << " < 0: " << var << " = " << var << " + 1\n"
+      << "  if " << var << " > 3: ";
+  write_body(out, level + 1, depth);
+  out << "\n  " << var << " - 1\n"
+      << "end";
+}
+
+std::string make_script(const int functions, const int depth)
+{
+  std::ostringstream out;
+  for (auto i = 0; i != functions; ++i) {
+    out << "let f" << i << "(x) = ";
+    write_body(out, 0, depth);
+    out << '\n';
+  }
+  return out.str();
+}
+
+double ms_since(const std::chrono::steady_clock::time_point start)
+{
+  const auto finish = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(finish - start).count();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  builtin::init();
+
+  const auto functions = argc > 1 ? std::stoi(argv[1]) : 2000;
+  const auto depth = argc > 2 ? std::stoi(argv[2]) : 16;
+
+  const auto script = make_script(functions, depth);
+  if (argc > 3)
+    std::ofstream{argv[3]} << script;
+
+  std::istringstream input{script};
+  auto start = std::chrono::steady_clock::now();
+  const auto tokens = parser::tokenize(input);
+  const auto tokenized = ms_since(start);
+
+  start = std::chrono::steady_clock::now();
+  if (!parser::is_valid(tokens)) {
+    std::cerr << "generated script is invalid\n";
+    return 1;
+  }
+  const auto exprs = parser::parse(tokens);
+  const auto parsed = ms_since(start);
+
+  start = std::chrono::steady_clock::now();
+  vm::bytecode body;
+  body.emplace_back(vm::instruction::pnil);
+  for (const auto& i : exprs) {
+    const auto code = i->code();
+    body.emplace_back(vm::instruction::pop, 1);
+    body.append(code);
+  }
+  optimize_independent_block(body);
+  const auto compiled = ms_since(start);
+
+  start = std::chrono::steady_clock::now();
+  const auto env = gc::alloc<vm::environment>( );
+  builtin::make_base_env(env);
+  vm::machine vm{vm::call_frame{body, env}};
+  vm.run();
+  const auto ran = ms_since(start);
+
+  std::cout << script.size() / 1024 << " KiB script, " << functions
+            << " functions nested " << depth << " deep\n"
+            << "  tokenize: " << tokenized << " ms\n"
+            << "  parse:    " << parsed << " ms\n"
+            << "  compile:  " << compiled << " ms\n"
+            << "  run:      " << ran << " ms\n";
+}
@@ -0,0 +1,107 @@
+// Compares value::dictionary's map against the std::unordered_map it replaced
+// (which hashed and compared every key through vv::hash_for and vv::equals),
+// on lookups by integer, symbol, and string keys. String keys are looked up by
+// a copy of the string stored in the map, as they would be when, say,
+// counting the words in a file.
+//
+// Usage: bench_dictionary [repetitions]
+
+#include "builtins.h"
+#include "gc.h"
+#include "vm.h"
+#include "gc/alloc.h"
+#include "value/array.h"
+#include "value/dictionary.h"
+#include "value/string.h"
+
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+
+using namespace vv;
+
+namespace {
+
+struct old_hasher {
+  size_t operator()(gc::managed_ptr obj) const { return hash_for(obj); }
+};
+struct old_key_equal {
+  bool operator()(gc::managed_ptr lhs, gc::managed_ptr rhs) const
+  {
+    return equals(lhs, rhs);
+  }
+};
+using old_dictionary = std::unordered_map<gc::managed_ptr, gc::managed_ptr,
+                                          old_hasher, old_key_equal>;
+
+// Sink for lookup results, so they can't be optimized away.
+volatile size_t g_sink;
+
+template <typename Dict>
+double time_lookups(const std::vector<gc::managed_ptr>& keys,
+                    const std::vector<gc::managed_ptr>& lookups,
+                    const int repetitions)
+{
+  Dict dict;
+  for (auto i : keys)
+    dict[i] = i;
+
+  const auto start = std::chrono::steady_clock::now();
+  size_t found = 0;
+  for (auto rep = repetitions; rep--;) {
+    for (auto i : lookups)
+      found += dict.find(i) != std::end(dict);
+  }
+  g_sink = found;
+  const auto finish = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(finish - start).count();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  builtin::init();
+  const auto repetitions = argc > 1 ? std::stoi(argv[1]) : 20;
+
+  // Everything's kept in this array, so it survives any collections
+  vm::machine vm{vm::call_frame{}};
+  vm.parr(0);
+  const auto root = vm.top();
+  const auto keep = [root](gc::managed_ptr obj)
+  {
+    value::get<value::array>(root).push_back(obj);
+    gc::write_barrier(root);
+    return obj;
+  };
+
+  std::vector<std::pair<std::string, std::vector<gc::managed_ptr>>> key_sets{
+    {"integer", {}}, {"symbol", {}}, {"string", {}}
+  };
+  std::vector<std::vector<gc::managed_ptr>> lookup_sets(3);
+  for (auto i = 0; i != 1000; ++i) {
+    const auto name = "key number " + std::to_string(i);
+    const auto integer = gc::alloc<value::integer>( value::integer{i * 7} );
+    const auto sym = symbol{name}.ptr();
+    key_sets[0].second.push_back(integer);
+    key_sets[1].second.push_back(sym);
+    key_sets[2].second.push_back(keep(gc::alloc<value::string>( name )));
+    for (auto j = 0; j != 10; ++j) {
+      lookup_sets[0].push_back(integer);
+      lookup_sets[1].push_back(sym);
+      lookup_sets[2].push_back(keep(gc::alloc<value::string>( name )));
+    }
+  }
+
+  for (size_t i = 0; i != key_sets.size(); ++i) {
+    const auto& keys = key_sets[i].second;
+    const auto& lookups = lookup_sets[i];
+    const auto count = static_cast<double>(lookups.size()) * repetitions;
+    const auto old_time = time_lookups<old_dictionary>(keys, lookups, repetitions);
+    const auto new_time = time_lookups<value::dictionary::value_type>(keys, lookups,
+                                                                      repetitions);
+    std::cout << key_sets[i].first << " keys: " << old_time * 1e9 / count
+              << " ns -> " << new_time * 1e9 / count << " ns per lookup ("
+              << old_time / new_time << "x)\n";
+  }
+}
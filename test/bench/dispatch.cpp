@@ -0,0 +1,104 @@
+// Measures per-instruction dispatch overhead of the VM for a couple of the
+// example programs, under each dispatch strategy vm::machine supports, along
+// with how often method lookups hit their inline caches.
+//
+// Usage: bench_dispatch [repetitions]
+
+#include "builtins.h"
+#include "get_file_contents.h"
+#include "opt.h"
+#include "vm.h"
+#include "gc/alloc.h"
+#include "value/array.h"
+#include "value/string.h"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+using namespace vv;
+
+namespace {
+
+struct script {
+  std::string filename;
+  std::vector<std::string> args;
+  int repetitions;
+};
+
+struct timing {
+  double seconds;
+  size_t instructions;
+};
+
+timing run_script(const script& scr, const vm::machine::dispatch mode)
+{
+  auto contents = get_file_contents(scr.filename);
+  if (!contents.successful()) {
+    std::cerr << contents.error() << '\n';
+    exit(1);
+  }
+  optimize_independent_block(contents.result());
+
+  // Scripts print as they go, which we're not interested in timing
+  std::ostringstream discarded;
+  const auto old_buf = std::cout.rdbuf(discarded.rdbuf());
+
+  timing res{0, 0};
+  for (auto i = scr.repetitions; i--;) {
+    const auto env = gc::alloc<vm::environment>( );
+    builtin::make_base_env(env);
+    vm::machine vm{vm::call_frame{contents.result(), env}};
+    vm.set_dispatch(mode);
+
+    const auto argv = gc::alloc<value::array>( );
+    value::get<vm::environment>(env).members[{"argv"}] = argv;
+    for (const auto& arg : scr.args)
+      value::get<value::array>(argv).push_back(gc::alloc<value::string>( arg ));
+
+    const auto start = std::chrono::steady_clock::now();
+    vm.run();
+    const auto finish = std::chrono::steady_clock::now();
+
+    res.seconds += std::chrono::duration<double>(finish - start).count();
+    res.instructions += vm.instructions_executed();
+    discarded.str("");
+  }
+
+  std::cout.rdbuf(old_buf);
+  return res;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  builtin::init();
+
+  const auto scale = argc > 1 ? std::stoi(argv[1]) : 1;
+  const std::vector<script> scripts{
+    { VV_EXAMPLES_DIR "/primes.vv",         {"5000"}, 20 * scale },
+    { VV_EXAMPLES_DIR "/bf-interpreter.vv", {},       200 * scale }
+  };
+
+  for (const auto& scr : scripts) {
+    // Count instructions once, so the other modes can be normalized by it
+    const auto counted = run_script(scr, vm::machine::dispatch::counting);
+    const auto portable = run_script(scr, vm::machine::dispatch::portable);
+    const auto hits = vm::method_cache::hits();
+    const auto misses = vm::method_cache::misses();
+    const auto threaded = run_script(scr, vm::machine::dispatch::threaded);
+    const auto run_hits = vm::method_cache::hits() - hits;
+    const auto run_misses = vm::method_cache::misses() - misses;
+
+    const auto instrs = static_cast<double>(counted.instructions);
+    std::cout << scr.filename << " (" << counted.instructions
+              << " instructions)\n"
+              << "  portable: " << portable.seconds * 1e3 << " ms, "
+              << portable.seconds * 1e9 / instrs << " ns/instruction\n"
+              << "  threaded: " << threaded.seconds * 1e3 << " ms, "
+              << threaded.seconds * 1e9 / instrs << " ns/instruction\n"
+              << "  method cache: " << run_hits << " hits, "
+              << run_misses << " misses\n";
+  }
+}
@@ -0,0 +1,122 @@
+// Compares vv::hash_map against the separately chained map it replaced, on the
+// kinds of maps Vivaldi actually uses: lots of short-lived maps with a handful
+// of entries (environments, object members), medium-sized ones that are
+// mostly read (method tables), and the occasional large one. Keys are
+// pointers, like vv::symbol.
+//
+// Usage: bench_hash_map [repetitions]
+
+#include "chained_hash_map.h"
+
+#include "utils/hash_map.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+using namespace vv;
+
+namespace {
+
+// Sink for lookup results, so they can't be optimized away.
+volatile size_t g_sink;
+
+template <template <typename, typename> class Map>
+double time_small(const std::vector<const int*>& keys, const int repetitions)
+{
+  const auto start = std::chrono::steady_clock::now();
+  size_t found = 0;
+  for (auto rep = repetitions; rep--;) {
+    // Fill a fresh map with 1-4 entries, then look up a few keys in it, some of
+    // which it contains
+    for (size_t i = 0; i + 8 <= keys.size(); i += 4) {
+      Map<const int*, size_t> map;
+      const auto sz = i / 4 % 4 + 1;
+      for (size_t j = 0; j != sz; ++j)
+        map[keys[i + j]] = j;
+      for (size_t j = 0; j != 8; ++j)
+        found += map.count(keys[i + j]);
+    }
+  }
+  g_sink = found;
+  const auto finish = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(finish - start).count();
+}
+
+template <template <typename, typename> class Map>
+double time_lookups(const std::vector<const int*>& keys,
+                    const size_t size,
+                    const int repetitions)
+{
+  Map<const int*, size_t> map;
+  for (size_t i = 0; i != size; ++i)
+    map[keys[i]] = i;
+
+  const auto start = std::chrono::steady_clock::now();
+  size_t found = 0;
+  for (auto rep = repetitions; rep--;) {
+    for (size_t i = 0; i != keys.size(); ++i)
+      found += map.find(keys[i % size])->second;
+  }
+  g_sink = found;
+  const auto finish = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(finish - start).count();
+}
+
+template <template <typename, typename> class Map>
+double time_inserts(const std::vector<const int*>& keys, const int repetitions)
+{
+  const auto start = std::chrono::steady_clock::now();
+  size_t sizes = 0;
+  for (auto rep = repetitions; rep--;) {
+    Map<const int*, size_t> map;
+    for (size_t i = 0; i != keys.size(); ++i)
+      map.insert(keys[i], i);
+    sizes += map.size();
+  }
+  g_sink = sizes;
+  const auto finish = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(finish - start).count();
+}
+
+void report(const std::string& name, const double chained, const double open,
+            const double operations)
+{
+  std::cout << name << ": " << chained * 1e9 / operations << " ns -> "
+            << open * 1e9 / operations << " ns per operation ("
+            << chained / open << "x)\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  const auto repetitions = argc > 1 ? std::stoi(argv[1]) : 10;
+
+  // Allocated separately, so keys are spread out like real objects
+  std::vector<std::unique_ptr<int>> objects;
+  std::vector<const int*> keys;
+  for (auto i = 0; i != 100'000; ++i) {
+    objects.push_back(std::make_unique<int>(i));
+    keys.push_back(objects.back().get());
+  }
+  const auto count = static_cast<double>(keys.size()) * repetitions;
+
+  // Each group of four keys gets an average of 2.5 insertions and 8 lookups
+  report("small maps (1-4 entries)",
+         time_small<chained_hash_map>(keys, repetitions),
+         time_small<hash_map>(keys, repetitions),
+         count / 4 * 10.5);
+
+  for (const auto size : { size_t{20}, size_t{1000} }) {
+    report("lookups (" + std::to_string(size) + " entries)",
+           time_lookups<chained_hash_map>(keys, size, repetitions),
+           time_lookups<hash_map>(keys, size, repetitions),
+           count);
+  }
+
+  report("inserts (100000 entries)",
+         time_inserts<chained_hash_map>(keys, 1),
+         time_inserts<hash_map>(keys, 1),
+         static_cast<double>(keys.size()));
+}
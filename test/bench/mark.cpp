@@ -0,0 +1,70 @@
+// Measures how full collections scale with the number of marking threads, on a
+// heap of a few million live objects (arrays of strings and floats, some of
+// them nested, roughly the shape of data a script might keep around).
+//
+// Usage: bench_mark [millions of objects] [max threads]
+
+#include "builtins.h"
+#include "gc.h"
+#include "vm.h"
+#include "gc/alloc.h"
+#include "value/array.h"
+#include "value/floating_point.h"
+#include "value/string.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace vv;
+
+int main(int argc, char** argv)
+{
+  builtin::init();
+
+  const auto millions = argc > 1 ? std::stoi(argv[1]) : 2;
+  const auto max_threads = argc > 2 ? static_cast<unsigned>(std::stoi(argv[2]))
+                                    : std::max(std::thread::hardware_concurrency(), 4u);
+
+  vm::machine vm{vm::call_frame{}};
+  vm.parr(0);
+  const auto root = vm.top();
+
+  // Rows of 1000 objects each, every tenth of which is a small nested array
+  const auto rows = static_cast<size_t>(millions) * 1000;
+  for (size_t i = 0; i != rows; ++i) {
+    const auto row = gc::alloc<value::array>( );
+    value::get<value::array>(root).push_back(row);
+    gc::write_barrier(root);
+
+    for (auto j = 0; j != 1000; ++j) {
+      gc::managed_ptr elem;
+      if (j % 10 == 0)
+        elem = gc::alloc<value::array>( );
+      else if (j % 2)
+        elem = gc::alloc<value::string>( std::string{"element"} );
+      else
+        elem = gc::alloc<value::floating_point>( j * 0.5 );
+      value::get<value::array>(row).push_back(elem);
+      gc::write_barrier(row);
+    }
+  }
+
+  std::cout << "heap of " << rows * 1001 << " live objects\n";
+
+  double single{};
+  for (auto threads = 1u; threads <= max_threads; threads *= 2) {
+    gc::set_mark_threads(threads);
+    // One collection to finish sweeping up after the last, and one to time
+    gc::collect();
+    const auto start = std::chrono::steady_clock::now();
+    gc::collect();
+    const auto finish = std::chrono::steady_clock::now();
+
+    const auto ms = std::chrono::duration<double, std::milli>(finish - start).count();
+    if (threads == 1)
+      single = ms;
+    std::cout << "  " << threads << " thread(s): " << ms << " ms ("
+              << single / ms << "x)\n";
+  }
+}
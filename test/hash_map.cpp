@@ -5,6 +5,8 @@
 #include <boost/test/included/unit_test.hpp>
 #include <boost/test/parameterized_test.hpp>
 
+#include <string>
+
 BOOST_AUTO_TEST_CASE(check_default_ctor)
 {
   vv::hash_map<int, int> map;
@@ -48,6 +50,73 @@ BOOST_AUTO_TEST_CASE(check_at_fn)
   BOOST_CHECK_THROW(map.at(500), std::out_of_range);
 }
 
+BOOST_AUTO_TEST_CASE(check_insert)
+{
+  vv::hash_map<std::string, std::string> map{ {"foo", "bar"} };
+  BOOST_CHECK_EQUAL(1, map.size());
+  map.insert("foo", "baz");
+  BOOST_CHECK_EQUAL(1, map.size());
+  BOOST_CHECK_EQUAL("baz", map.at("foo"));
+
+  // Across the switch from inline elements to a table, and then as it grows
+  for (auto i = 0; i < 100; ++i) {
+    map.insert(std::to_string(i), std::to_string(i * 2));
+    BOOST_CHECK_EQUAL(i + 2, map.size());
+    for (auto j = 0; j <= i; ++j)
+      BOOST_CHECK_EQUAL(std::to_string(j * 2), map.at(std::to_string(j)));
+  }
+  BOOST_CHECK_EQUAL("baz", map.at("foo"));
+  BOOST_CHECK(map.find("100") == std::end(map));
+}
+
+BOOST_AUTO_TEST_CASE(check_iteration)
+{
+  for (auto sz : { 0, 1, 4, 5, 13, 1000 }) {
+    vv::hash_map<int, int> map;
+    for (auto i = 0; i < sz; ++i)
+      map[i * 7] = i;
+
+    std::vector<int> seen(static_cast<size_t>(sz));
+    for (const auto& i : map) {
+      BOOST_CHECK_EQUAL(i.first, i.second * 7);
+      ++seen[static_cast<size_t>(i.second)];
+    }
+    BOOST_CHECK(std::all_of(begin(seen), end(seen), [](auto i) { return i == 1; }));
+
+    const auto found = map.find(0);
+    if (sz) {
+      BOOST_CHECK_EQUAL(found->first, 0);
+      ++map.find(0)->second;
+      BOOST_CHECK_EQUAL(map[0], 1);
+    }
+    else {
+      BOOST_CHECK(found == std::end(map));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(check_copy)
+{
+  for (auto sz : { 3, 300 }) {
+    vv::hash_map<int, int> map;
+    for (auto i = 0; i < sz; ++i)
+      map[i] = i;
+
+    auto copy = map;
+    for (auto i = 0; i < sz; ++i)
+      copy[i] = -i;
+    copy[sz] = sz;
+
+    BOOST_CHECK_EQUAL(sz, map.size());
+    BOOST_CHECK_EQUAL(sz + 1, copy.size());
+    BOOST_CHECK_EQUAL(0, map.count(sz));
+    for (auto i = 1; i < sz; ++i) {
+      BOOST_CHECK_EQUAL(i, map.at(i));
+      BOOST_CHECK_EQUAL(-i, copy.at(i));
+    }
+  }
+}
+
 boost::unit_test::test_suite* init_unit_test_suite(int argc, char** argv)
 {
   return nullptr;
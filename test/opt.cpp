@@ -0,0 +1,193 @@
+#include "output.h"
+
+#include "opt.h"
+#include "vm/instruction.h"
+
+#include <boost/test/included/unit_test.hpp>
+
+using vv::vm::instruction;
+
+// Local variable instructions are expected to have their variable's slot as
+// their argument, rather than the index of the variable in the constant pool.
+void check_code(const vv::vm::bytecode& code,
+                const std::vector<vv::vm::command>& expected)
+{
+  BOOST_REQUIRE_EQUAL(code.size(), expected.size());
+  for (size_t i{}; i != expected.size(); ++i) {
+    const auto& com = code.commands[i];
+    BOOST_CHECK_EQUAL(static_cast<int>(com.instr),
+                      static_cast<int>(expected[i].instr));
+    switch (com.instr) {
+    case instruction::lread:
+    case instruction::lwrite:
+    case instruction::llet:
+      BOOST_CHECK_EQUAL(code.constants.locals[com.as_const()].slot, expected[i].arg);
+      break;
+    default:
+      BOOST_CHECK_EQUAL(com.arg, expected[i].arg);
+    }
+  }
+}
+
+// Roughly
+//   let f(n) = do
+//     let k = n
+//     let c = 5
+//     while k: k = k + c
+//     k
+//   end
+BOOST_AUTO_TEST_CASE(check_loop_optimization)
+{
+  const vv::vm::local_variable k{0, 0, vv::symbol{"k"}};
+  const vv::vm::local_variable c{0, 1, vv::symbol{"c"}};
+
+  vv::vm::bytecode code;
+  code.emplace_back(instruction::arg, 0);
+  code.emplace_back(instruction::llet, k);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::pint, 5);
+  code.emplace_back(instruction::llet, c);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::lread, k);
+  code.emplace_back(instruction::jf, 7);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::lread, c);
+  code.emplace_back(instruction::lread, k);
+  code.emplace_back(instruction::opt_add);
+  code.emplace_back(instruction::lwrite, k);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::jmp, -9);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::lread, k);
+  code.emplace_back(instruction::ret, false);
+
+  vv::optimize_independent_block(code);
+
+  // c is replaced by its value inside the loop, its store is removed, and the
+  // jumps are moved to match
+  check_code(code, {
+    {instruction::arg, 0},
+    {instruction::llet, 0},
+    {instruction::pop, 1},
+    {instruction::lread, 0},
+    {instruction::jf, 7},
+    {instruction::pop, 1},
+    {instruction::pint, 5},
+    {instruction::lread, 0},
+    {instruction::opt_add},
+    {instruction::lwrite, 0},
+    {instruction::pop, 1},
+    {instruction::jmp, -9},
+    {instruction::pop, 1},
+    {instruction::lread, 0},
+    {instruction::ret, false}
+  });
+}
+
+// Roughly
+//   let f() = do
+//     cond true: return 1
+//     return 2
+//   end
+BOOST_AUTO_TEST_CASE(check_unreachable_code)
+{
+  vv::vm::bytecode code;
+  code.emplace_back(instruction::pbool, true);
+  code.emplace_back(instruction::jf, 3);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::pint, 1);
+  code.emplace_back(instruction::ret, false);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::pint, 2);
+  code.emplace_back(instruction::ret, false);
+
+  vv::optimize_independent_block(code);
+
+  check_code(code, {
+    {instruction::pint, 1},
+    {instruction::ret, false}
+  });
+}
+
+// Stores to variables a closure can see are left alone, even if they're never
+// read directly.
+BOOST_AUTO_TEST_CASE(check_captured_stores)
+{
+  const vv::vm::local_variable x{0, 0, vv::symbol{"x"}};
+
+  vv::vm::bytecode code;
+  code.emplace_back(instruction::pint, 1);
+  code.emplace_back(instruction::llet, x);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::pfn, vv::vm::function_t{0, {}, false, 0});
+  code.emplace_back(instruction::ret, false);
+
+  vv::optimize_independent_block(code);
+
+  BOOST_REQUIRE_EQUAL(code.size(), 5);
+  BOOST_CHECK(code.commands[1].instr == instruction::llet);
+}
+
+// Roughly
+//   let f(a) = do
+//     do
+//       let x = 1
+//       do
+//         let y = x
+//         fn (): y
+//       end
+//     end
+//     do
+//       let z = a
+//       z()
+//       z
+//     end
+//   end
+// Only blocks that nothing can capture have their environments reused.
+BOOST_AUTO_TEST_CASE(check_block_reuse)
+{
+  const vv::vm::local_variable x{0, 0, vv::symbol{"x"}};
+  const vv::vm::local_variable y{0, 0, vv::symbol{"y"}};
+  const vv::vm::local_variable outer_x{1, 0, vv::symbol{"x"}};
+  const vv::vm::local_variable z{0, 0, vv::symbol{"z"}};
+
+  vv::vm::bytecode code;
+  code.emplace_back(instruction::eblk, 1);
+  code.emplace_back(instruction::pint, 1);
+  code.emplace_back(instruction::llet, x);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::eblk, 1);
+  code.emplace_back(instruction::lread, outer_x);
+  code.emplace_back(instruction::llet, y);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::pfn, vv::vm::function_t{0, {}, false, 0});
+  code.emplace_back(instruction::lblk);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::lblk);
+  code.emplace_back(instruction::eblk, 1);
+  code.emplace_back(instruction::arg, 0);
+  code.emplace_back(instruction::llet, z);
+  code.emplace_back(instruction::call, 0);
+  code.emplace_back(instruction::pop, 1);
+  code.emplace_back(instruction::lread, z);
+  code.emplace_back(instruction::lblk);
+  code.emplace_back(instruction::ret, false);
+
+  vv::optimize(code);
+
+  std::vector<bool> reused;
+  for (const auto& i : code.commands) {
+    if (i.instr == instruction::lblk)
+      reused.push_back(i.as_bool());
+  }
+  // The closure captures both of the first two blocks
+  BOOST_REQUIRE_EQUAL(reused.size(), 3);
+  BOOST_CHECK(!reused[0]);
+  BOOST_CHECK(!reused[1]);
+  BOOST_CHECK(reused[2]);
+}
+
+boost::unit_test::test_suite* init_unit_test_suite(int, char**)
+{
+  return nullptr;
+}
@@ -0,0 +1,77 @@
+#include "output.h"
+
+#include "utils/ordered_hash_map.h"
+
+#include <boost/test/included/unit_test.hpp>
+#include <boost/test/parameterized_test.hpp>
+
+#include <string>
+
+namespace {
+
+// Deliberately terrible hash, so every key collides
+struct constant_hash {
+  size_t operator()(int) const { return 42; }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(check_default_ctor)
+{
+  vv::ordered_hash_map<int, int> map;
+  BOOST_CHECK_EQUAL(map.size(), 0);
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK(std::begin(map) == std::end(map));
+  for (auto i = -100; i < 100; ++i)
+    BOOST_CHECK_EQUAL(0, map.count(i));
+}
+
+BOOST_AUTO_TEST_CASE(check_at_operator)
+{
+  vv::ordered_hash_map<std::string, int> map;
+  for (auto i = -500; i < 500; ++i)
+    map[std::to_string(i)] = i * 2;
+  BOOST_CHECK_EQUAL(1000, map.size());
+  for (auto i = -500; i < 500; ++i) {
+    BOOST_CHECK_EQUAL(1, map.count(std::to_string(i)));
+    BOOST_CHECK_EQUAL(i * 2, map.find(std::to_string(i))->second);
+  }
+  BOOST_CHECK(map.find("500") == std::end(map));
+
+  for (auto i = -500; i < 500; ++i)
+    map[std::to_string(i)] = i * 3;
+  BOOST_CHECK_EQUAL(1000, map.size());
+  for (auto i = -500; i < 500; ++i)
+    BOOST_CHECK_EQUAL(i * 3, map[std::to_string(i)]);
+}
+
+BOOST_AUTO_TEST_CASE(check_insertion_order)
+{
+  vv::ordered_hash_map<int, int> map{ {5, 0}, {-3, 1} };
+  for (auto i = 100; i--;)
+    map[i * 7] = static_cast<int>(map.size());
+  // Reassigning an element doesn't move it
+  map[5] = 0;
+
+  auto expected = 0;
+  for (const auto& i : map)
+    BOOST_CHECK_EQUAL(i.second, expected++);
+  BOOST_CHECK_EQUAL(102, expected);
+  BOOST_CHECK_EQUAL(5, std::begin(map)->first);
+}
+
+BOOST_AUTO_TEST_CASE(check_collisions)
+{
+  vv::ordered_hash_map<int, int, constant_hash> map;
+  for (auto i = 0; i < 100; ++i)
+    map[i] = -i;
+  BOOST_CHECK_EQUAL(100, map.size());
+  for (auto i = 0; i < 100; ++i)
+    BOOST_CHECK_EQUAL(-i, map.find(i)->second);
+  BOOST_CHECK_EQUAL(0, map.count(100));
+}
+
+boost::unit_test::test_suite* init_unit_test_suite(int, char**)
+{
+  return nullptr;
+}
@@ -4,11 +4,13 @@
 #include "gc/alloc.h"
 #include "utils/string_helpers.h"
 #include "value/floating_point.h"
+#include "value/regex.h"
 #include "value/string.h"
 
 #include <boost/test/included/unit_test.hpp>
 #include <boost/test/parameterized_test.hpp>
 
+#include <limits>
 #include <numeric>
 
 void check_int(const vv::value::integer orig)
@@ -44,6 +46,27 @@ void check_float(const double orig)
   BOOST_CHECK_EQUAL(orig, val);
 }
 
+BOOST_AUTO_TEST_CASE(check_unboxed_float)
+{
+  BOOST_CHECK(vv::gc::alloc<vv::value::floating_point>( 1.5 ).is_immediate());
+  BOOST_CHECK(vv::gc::alloc<vv::value::floating_point>( -1e6 ).is_immediate());
+  BOOST_CHECK(!vv::gc::alloc<vv::value::floating_point>( 0.1 ).is_immediate());
+}
+
+// Unboxed floats are compared by value, not by their bits
+BOOST_AUTO_TEST_CASE(check_float_equality)
+{
+  const auto nan = vv::gc::alloc<vv::value::floating_point>(
+      std::numeric_limits<double>::quiet_NaN() );
+  BOOST_CHECK(nan.is_immediate());
+  BOOST_CHECK(!vv::equals(nan, nan));
+
+  const auto zero = vv::gc::alloc<vv::value::floating_point>( 0.0 );
+  const auto negative_zero = vv::gc::alloc<vv::value::floating_point>( -0.0 );
+  BOOST_CHECK(vv::equals(zero, negative_zero));
+  BOOST_CHECK(vv::equals(zero, zero));
+}
+
 BOOST_AUTO_TEST_CASE(check_nil)
 {
   const auto ptr = vv::gc::alloc<vv::value::nil>( );
@@ -69,6 +92,25 @@ BOOST_AUTO_TEST_CASE(check_default_string)
   BOOST_CHECK_EQUAL(vv::value::get<vv::value::string>(ptr), "");
 }
 
+BOOST_AUTO_TEST_CASE(check_rope)
+{
+  const std::string long_str(100, 'x');
+  const auto first = vv::gc::alloc<vv::value::string>( std::string{"foo"} );
+  const auto second = vv::gc::alloc<vv::value::string>( long_str );
+
+  // ((foo + long_str) + foo) + "bar"
+  auto rope = vv::gc::alloc<vv::value::string>( first, second, std::string{} );
+  rope = vv::gc::alloc<vv::value::string>( rope, first, std::string{} );
+  rope = vv::gc::alloc<vv::value::string>( rope, vv::gc::managed_ptr{}, std::string{"bar"} );
+
+  const auto& str = static_cast<vv::value::string&>(*rope.get());
+  BOOST_CHECK_EQUAL(vv::value::size_of(str), 109);
+  BOOST_CHECK(str.left);
+  BOOST_CHECK_EQUAL(vv::value::get<vv::value::string>(rope), "foo" + long_str + "foobar");
+  BOOST_CHECK(!str.left);
+  BOOST_CHECK_EQUAL(vv::value::size_of(str), 109);
+}
+
 void check_symbol(const vv::symbol orig)
 {
   const auto ptr = orig.ptr();//vv::gc::alloc<vv::value::symbol>( orig );
@@ -96,10 +138,15 @@ boost::unit_test::test_suite* init_unit_test_suite(int argc, char** argv)
   boost::unit_test::framework::master_test_suite().add(
     BOOST_PARAM_TEST_CASE(&check_bool, begin(bools), end(bools)));
 
-  std::array<double, 1002> doubles;
+  std::array<double, 1006> doubles;
   doubles[0] = std::numeric_limits<double>::min();
   doubles[1] = std::numeric_limits<double>::max();
-  std::iota(begin(doubles) + 2, end(doubles), -500.0);
+  // Floats too precise to be unboxed
+  doubles[2] = 0.1;
+  doubles[3] = 1.0 / 3;
+  doubles[4] = -0.0;
+  doubles[5] = std::numeric_limits<double>::infinity();
+  std::iota(begin(doubles) + 6, end(doubles), -500.0);
   boost::unit_test::framework::master_test_suite().add(
     BOOST_PARAM_TEST_CASE(&check_float, begin(doubles), end(doubles)));
 
@@ -113,3 +160,25 @@ boost::unit_test::test_suite* init_unit_test_suite(int argc, char** argv)
 
   return nullptr;
 }
+
+BOOST_AUTO_TEST_CASE(check_regex_prefix)
+{
+  BOOST_CHECK_EQUAL(vv::compiled_regex{"foo.*bar"}.prefix(), "foo");
+  BOOST_CHECK_EQUAL(vv::compiled_regex{"foo+"}.prefix(), "fo");
+  BOOST_CHECK_EQUAL(vv::compiled_regex{"\\.txt$"}.prefix(), ".txt");
+  BOOST_CHECK_EQUAL(vv::compiled_regex{"\\d+px"}.prefix(), "");
+  BOOST_CHECK_EQUAL(vv::compiled_regex{"a\\.b\\d"}.prefix(), "a.b");
+  BOOST_CHECK_EQUAL(vv::compiled_regex{"foo(a|b)"}.prefix(), "foo");
+  BOOST_CHECK_EQUAL(vv::compiled_regex{"foo|bar"}.prefix(), "");
+  BOOST_CHECK_EQUAL(vv::compiled_regex{"foo[|]"}.prefix(), "foo");
+
+  const std::string str{"foox, foo1bar"};
+  std::smatch results;
+  BOOST_CHECK(vv::compiled_regex{"foo([0-9])"}.search(str, results));
+  BOOST_CHECK_EQUAL(results[0].first - begin(str), 6);
+  BOOST_CHECK_EQUAL(results[1].str(), "1");
+  BOOST_CHECK(!vv::compiled_regex{"foo[a-w]"}.search(str, results));
+  const std::string words{"foox foo"};
+  BOOST_CHECK(vv::compiled_regex{"foo\\b"}.search(words, results));
+  BOOST_CHECK_EQUAL(results[0].first - begin(words), 5);
+}
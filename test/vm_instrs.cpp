@@ -1,6 +1,7 @@
 #include "output.h"
 
 #include "builtins.h"
+#include "gc.h"
 #include "value.h"
 #include "vm.h"
 #include "gc/alloc.h"
@@ -8,11 +9,14 @@
 #include "value/array.h"
 #include "value/floating_point.h"
 #include "value/function.h"
+#include "value/object.h"
 #include "value/string.h"
 
+#include <boost/filesystem.hpp>
 #include <boost/test/included/unit_test.hpp>
 #include <boost/test/parameterized_test.hpp>
 
+#include <fstream>
 #include <numeric>
 
 BOOST_AUTO_TEST_CASE(check_pbool)
@@ -58,15 +62,21 @@ void check_pfn(const int argc)
 {
   vv::vm::machine vm{vv::vm::call_frame{}};
 
-  vm.pfn({ argc, { {vv::vm::instruction::pnil} } });
+  const auto proto = std::make_shared<const vv::vm::function_t>(
+      vv::vm::function_t{ argc, { {vv::vm::instruction::pnil} } });
+  vm.pfn(proto);
   const auto fn = vm.top();
   BOOST_CHECK_EQUAL(fn.tag(), vv::tag::function);
   BOOST_CHECK(fn.type() == vv::builtin::type::function);
-  BOOST_CHECK_EQUAL(vv::value::get<vv::value::function>(fn).argc, argc);
+  BOOST_CHECK_EQUAL(vv::value::get<vv::value::function>(fn).prototype->argc, argc);
 
-  const auto& body = vv::value::get<vv::value::function>(fn).body;
+  const auto& body = vv::value::get<vv::value::function>(fn).prototype->body;
   BOOST_CHECK_EQUAL(body.size(), 1);
   BOOST_CHECK(body[0].instr == vv::vm::instruction::pnil);
+
+  // Closures created from the same definition share a body
+  vm.pfn(proto);
+  BOOST_CHECK(vv::value::get<vv::value::function>(vm.top()).prototype == proto);
 }
 
 void check_pint(const int orig)
@@ -155,6 +165,252 @@ BOOST_AUTO_TEST_CASE(check_read)
   BOOST_CHECK_THROW(vm.read(vv::symbol{"I don't exist"}), vv::vm_error);
 }
 
+BOOST_AUTO_TEST_CASE(check_lread)
+{
+  vv::vm::call_frame frame{};
+  frame.env().slots.resize(2);
+  frame.env().members[vv::symbol{"bar"}] = vv::gc::alloc<vv::value::integer>(vv::value::integer{2});
+  vv::vm::machine vm{std::move(frame)};
+
+  const vv::vm::local_variable foo_var{0, 0, vv::symbol{"foo"}};
+  vm.pint(1);
+  vm.llet(foo_var);
+  vm.pop(1);
+  vm.lread(foo_var);
+  const auto foo = vm.top();
+  BOOST_CHECK_EQUAL(foo.tag(), vv::tag::integer);
+  BOOST_CHECK_EQUAL(vv::value::get<vv::value::integer>(foo), 1);
+  BOOST_CHECK_THROW(vm.llet(foo_var), vv::vm_error);
+
+  // Uninitialized slots fall back to looking the variable up by name
+  vm.lread({0, 1, vv::symbol{"bar"}});
+  const auto bar = vm.top();
+  BOOST_CHECK_EQUAL(bar.tag(), vv::tag::integer);
+  BOOST_CHECK_EQUAL(vv::value::get<vv::value::integer>(bar), 2);
+}
+
+BOOST_AUTO_TEST_CASE(check_method_cache)
+{
+  const vv::symbol add{"add"};
+  const auto method = vv::get_method(vv::builtin::type::integer, add);
+
+  vv::vm::method_cache cache;
+  BOOST_CHECK(cache.lookup(vv::builtin::type::integer, add) == method);
+  BOOST_CHECK_EQUAL(cache.size(), 1);
+  const auto hits = vv::vm::method_cache::hits();
+  BOOST_CHECK(cache.lookup(vv::builtin::type::integer, add) == method);
+  BOOST_CHECK_EQUAL(vv::vm::method_cache::hits(), hits + 1);
+
+  // Failed lookups aren't cached
+  vv::vm::method_cache missing;
+  BOOST_CHECK(!missing.lookup(vv::builtin::type::integer, vv::symbol{"nope"}));
+  BOOST_CHECK_EQUAL(missing.size(), 0);
+
+  const auto string_method = vv::get_method(vv::builtin::type::string, add);
+  BOOST_CHECK(cache.lookup(vv::builtin::type::string, add) == string_method);
+  BOOST_CHECK_EQUAL(cache.size(), 2);
+
+  vv::vm::method_cache::invalidate_all();
+  BOOST_CHECK_EQUAL(cache.size(), 0);
+  BOOST_CHECK(cache.lookup(vv::builtin::type::string, add) == string_method);
+}
+
+// Nothing but the VM's record of a required file refers to the environment it
+// ran in, which has to survive collections for requiring it again to work.
+BOOST_AUTO_TEST_CASE(check_module_collection)
+{
+  namespace fs = boost::filesystem;
+  const auto dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directory(dir);
+  const auto file = (dir / "collected.vv").native();
+  const vv::symbol collected{"collected"};
+
+  std::ofstream{file} << "let collected = \"module\"\n";
+  vv::vm::machine vm{vv::vm::call_frame{}};
+  vm.req(file);
+  vm.run_cur_scope();
+  vm.pop(1);
+
+  vm.pint(0);
+  vm.write(collected);
+  vm.pop(1);
+  // The second collection finishes sweeping whatever the first left dead, and
+  // entering blocks then reuses the memory of any environments it freed
+  vv::gc::collect();
+  vv::gc::collect();
+  for (auto i = 0; i != 10000; ++i) {
+    vm.eblk(0);
+    vm.lblk(false);
+  }
+
+  vm.req(file);
+  vm.pop(1);
+  vm.read(collected);
+  BOOST_REQUIRE_EQUAL(vm.top().tag(), vv::tag::string);
+  BOOST_CHECK_EQUAL(vv::value::get<vv::value::string>(vm.top()), "module");
+
+  fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(check_reload_modules)
+{
+  namespace fs = boost::filesystem;
+  const auto dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directory(dir);
+  const auto file = (dir / "reloaded.vv").native();
+  const vv::symbol reloaded{"reloaded"};
+
+  const auto reloaded_value = [&](vv::vm::machine& vm)
+  {
+    vm.read(reloaded);
+    const auto val = vm.top();
+    vm.pop(1);
+    return vv::value::get<vv::value::integer>(val);
+  };
+
+  std::ofstream{file} << "let reloaded = 1\n";
+  vv::vm::machine vm{vv::vm::call_frame{}};
+  vm.req(file);
+  vm.run_cur_scope();
+  vm.pop(1);
+  BOOST_CHECK_EQUAL(reloaded_value(vm), 1);
+
+  // Modification times only have a resolution of a second, so move the new
+  // file's forward to be sure it's noticed
+  const auto modified = fs::last_write_time(file);
+  std::ofstream{file} << "let reloaded = 2\n";
+  fs::last_write_time(file, modified + 10);
+
+  // By default, the file's only ever run once
+  vm.req(file);
+  vm.pop(1);
+  BOOST_CHECK_EQUAL(reloaded_value(vm), 1);
+
+  vm.set_reload_modules(true);
+  vm.req(file);
+  vm.run_cur_scope();
+  vm.pop(1);
+  BOOST_CHECK_EQUAL(reloaded_value(vm), 2);
+
+  fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(check_minor_collection)
+{
+  vv::vm::machine vm{vv::vm::call_frame{}};
+  vm.parr(0);
+  const auto arr = vm.top();
+
+  const auto minor = vv::gc::stats().minor;
+  for (auto i = 0; i != 100000; ++i) {
+    vm.pstr("garbage");
+    vm.pop(1);
+  }
+  BOOST_CHECK(vv::gc::stats().minor > minor);
+
+  // arr has survived a collection, so storing a new object in it requires a
+  // write barrier to keep that object alive
+  vv::value::get<vv::value::array>(arr).push_back(
+      vv::gc::alloc<vv::value::string>(vv::value::string{"kept"}));
+  vv::gc::write_barrier(arr);
+  for (auto i = 0; i != 100000; ++i) {
+    vm.pstr("garbage");
+    vm.pop(1);
+  }
+  const auto kept = vv::value::get<vv::value::array>(arr).front();
+  BOOST_CHECK_EQUAL(vv::value::get<vv::value::string>(kept), "kept");
+}
+
+BOOST_AUTO_TEST_CASE(check_full_collection)
+{
+  vv::vm::machine vm{vv::vm::call_frame{}};
+
+  // Deep enough to overflow the native stack if marking recursed
+  vm.parr(0);
+  auto innermost = vm.top();
+  for (auto i = 0; i != 1'000'000; ++i) {
+    const auto arr = vv::gc::alloc<vv::value::array>( );
+    vv::value::get<vv::value::array>(innermost).push_back(arr);
+    vv::gc::write_barrier(innermost);
+    innermost = arr;
+  }
+  vv::value::get<vv::value::array>(innermost).push_back(
+      vv::gc::alloc<vv::value::string>(vv::value::string{"innermost"}));
+  vv::gc::write_barrier(innermost);
+
+  for (const auto threads : { 1u, 4u }) {
+    vv::gc::set_mark_threads(threads);
+    vv::gc::collect();
+    auto arr = vm.top();
+    while (vv::value::get<vv::value::array>(arr).front().tag() == vv::tag::array)
+      arr = vv::value::get<vv::value::array>(arr).front();
+    const auto str = vv::value::get<vv::value::array>(arr).front();
+    BOOST_CHECK_EQUAL(vv::value::get<vv::value::string>(str), "innermost");
+  }
+  vv::gc::set_mark_threads(1);
+}
+
+BOOST_AUTO_TEST_CASE(check_generic_members)
+{
+  vv::vm::machine vm{vv::vm::call_frame{}};
+  vm.parr(0);
+  const auto arr = vm.top();
+  vm.parr(0);
+  const auto other = vm.top();
+
+  vv::set_member(arr, {"foo"}, vv::gc::alloc<vv::value::string>(vv::value::string{"foo"}));
+  BOOST_CHECK(vv::has_member(arr, {"foo"}));
+  BOOST_CHECK(!vv::has_member(arr, {"bar"}));
+  BOOST_CHECK(!vv::get_member(arr, {"bar"}));
+  BOOST_CHECK(!vv::has_member(other, {"foo"}));
+  BOOST_CHECK(!vv::get_member(other, {"foo"}));
+
+  // Members are only reachable through their owner
+  vv::gc::collect();
+  for (auto i = 0; i != 100000; ++i) {
+    vm.pstr("garbage");
+    vm.pop(1);
+  }
+  const auto foo = vv::get_member(arr, {"foo"});
+  BOOST_CHECK_EQUAL(vv::value::get<vv::value::string>(foo), "foo");
+}
+
+BOOST_AUTO_TEST_CASE(check_member_cache)
+{
+  vv::value::object::members first{vv::value::shape::empty(), {}};
+  vv::value::object::members second{vv::value::shape::empty(), {}};
+  const auto foo = vv::gc::alloc<vv::value::string>(vv::value::string{"foo"});
+  const auto bar = vv::gc::alloc<vv::value::string>(vv::value::string{"bar"});
+
+  // Adding the same members in the same order gives the same shape, whether or
+  // not it's done through a cache
+  vv::vm::member_cache add_foo;
+  add_foo.write(first, {"foo"}, foo);
+  add_foo.write(second, {"foo"}, bar);
+  first.set({"bar"}, bar);
+  second.set({"bar"}, foo);
+  BOOST_CHECK_EQUAL(first.shape, second.shape);
+  BOOST_CHECK_EQUAL(first.shape->size(), 2u);
+
+  vv::vm::member_cache read_bar;
+  BOOST_CHECK(read_bar.read(first, {"bar"}) == bar);
+  BOOST_CHECK(read_bar.read(second, {"bar"}) == foo);
+  BOOST_CHECK(!vv::vm::member_cache{}.read(first, {"baz"}));
+
+  // Writing an existing member through a cache that's seen it added
+  add_foo.write(first, {"foo"}, bar);
+  BOOST_CHECK(first.find({"foo"}) == bar);
+  BOOST_CHECK_EQUAL(first.shape, second.shape);
+
+  // A different layout misses the cache, but still finds the right member
+  vv::value::object::members third{vv::value::shape::empty(), {}};
+  third.set({"bar"}, bar);
+  third.set({"foo"}, foo);
+  BOOST_CHECK(first.shape != third.shape);
+  BOOST_CHECK(read_bar.read(third, {"bar"}) == bar);
+  BOOST_CHECK(read_bar.read(first, {"bar"}) == bar);
+}
+
 boost::unit_test::test_suite* init_unit_test_suite(int argc, char** argv)
 {
   vv::builtin::init();